@@ -42,6 +42,47 @@ namespace dae
 		float DiffuseReflectance{ 7.f };
 	};
 
+	//Transformed vertices, one stream per attribute so every stage only reads the attributes it needs.
+	//Kept alive between frames, the vertex stage overwrites them in place.
+	struct VertexStreams
+	{
+		std::vector<Vector4> positions{};		//screen x and y, 1 / ndc depth, clip w
+		std::vector<Vector2> uvs{};
+		std::vector<Vector3> normals{};
+		std::vector<Vector3> tangents{};
+		std::vector<Vector3> viewDirections{};
+
+		size_t Size() const { return positions.size(); }
+
+		void Resize(size_t size)
+		{
+			positions.resize(size);
+			uvs.resize(size);
+			normals.resize(size);
+			tangents.resize(size);
+			viewDirections.resize(size);
+		}
+
+		void Clear()
+		{
+			Resize(0);
+		}
+
+		Vertex_Out Get(size_t index) const
+		{
+			return Vertex_Out{ positions[index], colors::White, uvs[index], normals[index], tangents[index], viewDirections[index] };
+		}
+
+		void PushBack(const Vertex_Out& vertex)
+		{
+			positions.push_back(vertex.position);
+			uvs.push_back(vertex.uv);
+			normals.push_back(vertex.normal);
+			tangents.push_back(vertex.tangent);
+			viewDirections.push_back(vertex.viewDirection);
+		}
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices{};
@@ -49,7 +90,11 @@ namespace dae
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 		Material material{};
 
-		std::vector<Vertex_Out> vertices_out{};
+		VertexStreams vertices_out{};
+		//vertices_out positions before the perspective divide
+		std::vector<Vector4> clipPositions{};
+		//frustum and guard band planes every vertex is outside of
+		std::vector<uint32_t> outcodes{};
 		Matrix worldMatrix{};
 
 		Matrix rotationTransform{};
@@ -75,25 +120,6 @@ namespace dae
 		{
 			worldMatrix = scaleTransform * rotationTransform * translationTransform;
 		}
-
-		void ResetVertices()
-		{
-			vertices_out.clear();
-			vertices_out.reserve(vertices.size());
-
-			for (size_t i = 0; i < vertices.size(); ++i)
-			{
-				Vertex_Out vertex_out{
-					{ vertices[i].position.x,vertices[i].position.y ,vertices[i].position.z ,1.f },
-					vertices[i].color,
-					vertices[i].uv,
-					vertices[i].normal,
-					vertices[i].tangent,
-					vertices[i].viewDirection
-				};
-				vertices_out.emplace_back(vertex_out);
-			}
-		}
 	};
 
 	struct BoundaryBox
@@ -101,4 +127,29 @@ namespace dae
 		Vector2 Smallest;
 		Vector2 Biggest;
 	};
+
+	//Triangle that made it through the vertex stage, the tiles it covers refer to it by its index in the frame
+	struct RasterTriangle
+	{
+		const VertexStreams* pVertices{};
+		uint32_t indices[3]{};
+		const Material* pMaterial{};
+	};
+
+	//triangles the culling stage dropped this frame, per reason
+	struct CullStatistics
+	{
+		uint32_t backFacing{};
+		uint32_t zeroArea{};
+		uint32_t offScreen{};
+	};
+
+	//what the visibility buffer keeps of a pixel, the frame triangle in front and the first two barycentric weights
+	struct VisibilitySample
+	{
+		static constexpr uint32_t NoTriangle{ UINT32_MAX };
+
+		uint32_t triangleIndex{ NoTriangle };
+		Vector2 weights{};
+	};
 }
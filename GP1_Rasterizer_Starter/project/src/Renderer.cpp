@@ -5,12 +5,22 @@
 //Project includes
 #include "Renderer.h"
 
+#include <algorithm>
+#include <bit>
+#include <execution>
 #include <iostream>
+#include <numeric>
 
 #include "Maths.h"
 #include "Texture.h"
 #include "Utils.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define PARALLEL_EXECUTION
+
 using namespace dae;
 
 Renderer::Renderer(SDL_Window* pWindow) :
@@ -25,6 +35,16 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_pVisibilityBuffer = new VisibilitySample[m_Width * m_Height];
+
+	m_TileCountX = (m_Width + TileSize - 1) / TileSize;
+	m_TileCountY = (m_Height + TileSize - 1) / TileSize;
+	m_TileIndices.resize(m_TileCountX * m_TileCountY);
+	std::iota(m_TileIndices.begin(), m_TileIndices.end(), 0);
+	m_TileBins.resize(m_TileIndices.size());
+
+	m_HiZWidth = (m_Width + HiZBlockSize - 1) / HiZBlockSize;
+	m_HiZ.resize(m_HiZWidth * ((m_Height + HiZBlockSize - 1) / HiZBlockSize));
 
 	InitializeSpaceBike();
 }
@@ -56,6 +76,7 @@ void Renderer::InitializeSpaceBike()
 Renderer::~Renderer()
 {
 	delete[] m_pDepthBufferPixels;
+	delete[] m_pVisibilityBuffer;
 	for (Mesh& mesh : m_Meshes)
 	{
 		delete mesh.material.pDiffuse;
@@ -89,11 +110,7 @@ void Renderer::Render()
 {
 	SDL_LockSurface(m_pBackBuffer);
 
-	//fill the whole depth buffer with max values so it can become smaller
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, std::numeric_limits<float>::max());
-	// Clear screen buffer
-	SDL_FillRect(m_pBackBuffer, nullptr, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
-
+	//every tile clears its own part of the depth and screen buffer
 	RasterizeMesh();
 
 	//@END
@@ -105,34 +122,162 @@ void Renderer::Render()
 
 void Renderer::VertexTransformationFunction(Mesh& mesh) const
 {
-	mesh.ResetVertices();
+	const size_t vertexCount{ mesh.vertices.size() };
+	mesh.vertices_out.Resize(vertexCount);
+	mesh.clipPositions.resize(vertexCount);
+	mesh.outcodes.resize(vertexCount);
 
 	const Matrix WorldViewProjectionMatrix = mesh.worldMatrix * m_Camera.m_ViewMatrix * m_Camera.m_ProjectionMatrix;
-
-	for (Vertex_Out& vertex : mesh.vertices_out)
+	VertexStreams& out = mesh.vertices_out;
+	size_t i{ 0 };
+
+#if defined(__AVX2__)
+	//8 vertices at a time, one register per component. The model vertices are gathered, the results go through
+	//a small buffer into the streams because those keep their components together.
+	static_assert(sizeof(Vertex) % sizeof(float) == 0);
+	const __m256i vertexOffsets{ _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(sizeof(Vertex) / sizeof(float))) };
+	const auto matrixElement{ [&](int row, int column) { return _mm256_set1_ps(WorldViewProjectionMatrix[row][column]); } };
+	const __m256 m00{ matrixElement(0, 0) }, m01{ matrixElement(0, 1) }, m02{ matrixElement(0, 2) }, m03{ matrixElement(0, 3) };
+	const __m256 m10{ matrixElement(1, 0) }, m11{ matrixElement(1, 1) }, m12{ matrixElement(1, 2) }, m13{ matrixElement(1, 3) };
+	const __m256 m20{ matrixElement(2, 0) }, m21{ matrixElement(2, 1) }, m22{ matrixElement(2, 2) }, m23{ matrixElement(2, 3) };
+	const __m256 m30{ matrixElement(3, 0) }, m31{ matrixElement(3, 1) }, m32{ matrixElement(3, 2) }, m33{ matrixElement(3, 3) };
+
+	const auto transform{ [](const __m256& x, const __m256& y, const __m256& z, const __m256& column0, const __m256& column1, const __m256& column2)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(column0, x), _mm256_mul_ps(column1, y)), _mm256_mul_ps(column2, z));
+		} };
+	const auto normalize{ [](__m256& x, __m256& y, __m256& z)
+		{
+			const __m256 magnitude{ _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z))) };
+			x = _mm256_div_ps(x, magnitude);
+			y = _mm256_div_ps(y, magnitude);
+			z = _mm256_div_ps(z, magnitude);
+		} };
+	const auto outsideBit{ [](const __m256& a, const __m256& b, uint32_t bit)
+		{
+			return _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)), _mm256_set1_epi32(static_cast<int>(bit)));
+		} };
+
+	const __m256 originX{ _mm256_set1_ps(m_Camera.m_Origin.x) };
+	const __m256 originY{ _mm256_set1_ps(m_Camera.m_Origin.y) };
+	const __m256 originZ{ _mm256_set1_ps(m_Camera.m_Origin.z) };
+	const __m256 halfWidth{ _mm256_set1_ps(static_cast<float>(m_Width) / 2.f) };
+	const __m256 halfHeight{ _mm256_set1_ps(static_cast<float>(m_Height) / 2.f) };
+	const __m256 one{ _mm256_set1_ps(1.f) };
+	const __m256 guardBand{ _mm256_set1_ps(GuardBand) };
+	const __m256 nearPlaneOffset{ _mm256_set1_ps(NearPlaneOffset) };
+
+	for (; i + 8 <= vertexCount; i += 8)
 	{
-		vertex.position =  WorldViewProjectionMatrix.TransformPoint(vertex.position);
+		const Vertex* pVertices{ mesh.vertices.data() + i };
+		const auto gather{ [&](const float* pComponent) { return _mm256_i32gather_ps(pComponent, vertexOffsets, 4); } };
+
+		const __m256 modelX{ gather(&pVertices->position.x) }, modelY{ gather(&pVertices->position.y) }, modelZ{ gather(&pVertices->position.z) };
+		const __m256 clipX{ _mm256_add_ps(transform(modelX, modelY, modelZ, m00, m10, m20), m30) };
+		const __m256 clipY{ _mm256_add_ps(transform(modelX, modelY, modelZ, m01, m11, m21), m31) };
+		const __m256 clipZ{ _mm256_add_ps(transform(modelX, modelY, modelZ, m02, m12, m22), m32) };
+		const __m256 clipW{ _mm256_add_ps(transform(modelX, modelY, modelZ, m03, m13, m23), m33) };
 
 		//transform the normal and tagents so its in the correct position
-		vertex.normal = WorldViewProjectionMatrix.TransformVector(vertex.normal).Normalized();
-		vertex.tangent = WorldViewProjectionMatrix.TransformVector(vertex.tangent).Normalized();
+		const __m256 modelNormalX{ gather(&pVertices->normal.x) }, modelNormalY{ gather(&pVertices->normal.y) }, modelNormalZ{ gather(&pVertices->normal.z) };
+		__m256 normalX{ transform(modelNormalX, modelNormalY, modelNormalZ, m00, m10, m20) };
+		__m256 normalY{ transform(modelNormalX, modelNormalY, modelNormalZ, m01, m11, m21) };
+		__m256 normalZ{ transform(modelNormalX, modelNormalY, modelNormalZ, m02, m12, m22) };
+		normalize(normalX, normalY, normalZ);
+
+		const __m256 modelTangentX{ gather(&pVertices->tangent.x) }, modelTangentY{ gather(&pVertices->tangent.y) }, modelTangentZ{ gather(&pVertices->tangent.z) };
+		__m256 tangentX{ transform(modelTangentX, modelTangentY, modelTangentZ, m00, m10, m20) };
+		__m256 tangentY{ transform(modelTangentX, modelTangentY, modelTangentZ, m01, m11, m21) };
+		__m256 tangentZ{ transform(modelTangentX, modelTangentY, modelTangentZ, m02, m12, m22) };
+		normalize(tangentX, tangentY, tangentZ);
 
 		//get the viewDirection
-		vertex.viewDirection = (vertex.position.GetXYZ() - m_Camera.m_Origin).Normalized();
+		__m256 viewX{ _mm256_sub_ps(clipX, originX) }, viewY{ _mm256_sub_ps(clipY, originY) }, viewZ{ _mm256_sub_ps(clipZ, originZ) };
+		normalize(viewX, viewY, viewZ);
+
+		const __m256 guardW{ _mm256_mul_ps(guardBand, clipW) };
+		const __m256 negativeW{ _mm256_sub_ps(_mm256_setzero_ps(), clipW) };
+		const __m256 negativeGuardW{ _mm256_sub_ps(_mm256_setzero_ps(), guardW) };
+		const __m256i outcodes{ _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(_mm256_or_si256(
+			outsideBit(clipX, negativeW, OutsideLeft), outsideBit(clipW, clipX, OutsideRight)),
+			_mm256_or_si256(outsideBit(clipY, negativeW, OutsideBottom), outsideBit(clipW, clipY, OutsideTop))),
+			_mm256_or_si256(_mm256_or_si256(outsideBit(clipZ, _mm256_mul_ps(nearPlaneOffset, clipW), OutsideNear), outsideBit(clipW, clipZ, OutsideFar)),
+			_mm256_or_si256(outsideBit(clipX, negativeGuardW, OutsideGuardLeft), outsideBit(guardW, clipX, OutsideGuardRight)))),
+			_mm256_or_si256(outsideBit(clipY, negativeGuardW, OutsideGuardBottom), outsideBit(guardW, clipY, OutsideGuardTop))) };
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(mesh.outcodes.data() + i), outcodes);
+
+		//same steps as ToScreenSpace
+		const __m256 ndcX{ _mm256_div_ps(clipX, clipW) };
+		const __m256 ndcY{ _mm256_div_ps(clipY, clipW) };
+		const __m256 ndcZ{ _mm256_div_ps(clipZ, clipW) };
+		const __m256 screenX{ _mm256_mul_ps(_mm256_add_ps(ndcX, one), halfWidth) };
+		const __m256 screenY{ _mm256_mul_ps(_mm256_sub_ps(one, ndcY), halfHeight) };
+		const __m256 inverseDepth{ _mm256_div_ps(one, ndcZ) };
+
+		alignas(32) float values[19][8];
+		const __m256 results[19]{ clipX, clipY, clipZ, clipW, screenX, screenY, inverseDepth,
+			normalX, normalY, normalZ, tangentX, tangentY, tangentZ, viewX, viewY, viewZ,
+			gather(&pVertices->uv.x), gather(&pVertices->uv.y), one };
+		for (int result = 0; result < 19; ++result)
+		{
+			_mm256_store_ps(values[result], results[result]);
+		}
+
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			mesh.clipPositions[i + lane] = { values[0][lane], values[1][lane], values[2][lane], values[3][lane] };
+			out.positions[i + lane] = { values[4][lane], values[5][lane], values[6][lane], values[3][lane] };
+			out.normals[i + lane] = { values[7][lane], values[8][lane], values[9][lane] };
+			out.tangents[i + lane] = { values[10][lane], values[11][lane], values[12][lane] };
+			out.viewDirections[i + lane] = { values[13][lane], values[14][lane], values[15][lane] };
+			out.uvs[i + lane] = { values[16][lane], values[17][lane] };
+		}
+	}
+#endif
 
-		vertex.position.x /= vertex.position.w;
-		vertex.position.y /= vertex.position.w;
-		vertex.position.z /= vertex.position.w;
+	for (; i < vertexCount; ++i)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		const Vector4 position = WorldViewProjectionMatrix.TransformPoint(Vector4{ vertex.position.x, vertex.position.y, vertex.position.z, 1.f });
 
-		vertex.position.z = 1.f / vertex.position.z;
+		//transform the normal and tagents so its in the correct position
+		out.normals[i] = WorldViewProjectionMatrix.TransformVector(vertex.normal).Normalized();
+		out.tangents[i] = WorldViewProjectionMatrix.TransformVector(vertex.tangent).Normalized();
+		out.uvs[i] = vertex.uv;
+
+		//get the viewDirection
+		out.viewDirections[i] = (position.GetXYZ() - m_Camera.m_Origin).Normalized();
 
-		vertex.position.x = (vertex.position.x + 1.f) / 2.f * static_cast<float>(m_Width);
-		vertex.position.y = (1.f - vertex.position.y) / 2.f * static_cast<float>(m_Height);
+		//triangles crossing the near plane are clipped before the divide means anything
+		mesh.clipPositions[i] = position;
+		mesh.outcodes[i] = GetOutcode(position);
+		out.positions[i] = position;
+		ToScreenSpace(out.positions[i]);
 	}
 }
 
+void Renderer::ToScreenSpace(Vector4& position) const
+{
+	position.x /= position.w;
+	position.y /= position.w;
+	position.z /= position.w;
+
+	position.z = 1.f / position.z;
+
+	position.x = (position.x + 1.f) / 2.f * static_cast<float>(m_Width);
+	position.y = (1.f - position.y) / 2.f * static_cast<float>(m_Height);
+}
+
 void Renderer::RasterizeMesh()
 {
+	m_Triangles.clear();
+	m_CullStatistics = {};
+	m_ClippedVertices.Clear();
+	for (std::vector<uint32_t>& bin : m_TileBins)
+	{
+		bin.clear();
+	}
+
 	for (Mesh& mesh : m_Meshes)
 	{
 		VertexTransformationFunction(mesh);
@@ -146,152 +291,683 @@ void Renderer::RasterizeMesh()
 			TriangleList(mesh);
 		}
 	}
+
+#if defined(PARALLEL_EXECUTION)
+	std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(), [this](uint32_t tileIndex) {
+		RasterizeTile(tileIndex);
+		});
+#else
+	for (uint32_t tileIndex : m_TileIndices)
+	{
+		RasterizeTile(tileIndex);
+	}
+#endif
 }
 void Renderer::TriangleStrip(const Mesh& mesh)
 {
+	//unrolled into a list, every odd triangle flipped so they all keep the same winding
+	m_StripTriangles.clear();
 	for (size_t i = 0; i < mesh.indices.size() - 2; i++)
 	{
-		size_t v0;
-		size_t v1;
-		size_t v2;
 		if (i % 2 == 0)
 		{
-			v0 = mesh.indices[i];
-			v1 = mesh.indices[i + 1];
-			v2 = mesh.indices[i + 2];
+			m_StripTriangles.insert(m_StripTriangles.end(), { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] });
 		}
 		else
 		{
-			v0 = mesh.indices[i];
-			v1 = mesh.indices[i + 2];
-			v2 = mesh.indices[i + 1];
+			m_StripTriangles.insert(m_StripTriangles.end(), { mesh.indices[i], mesh.indices[i + 2], mesh.indices[i + 1] });
 		}
-
-		Rasterize(mesh, v0, v1, v2);
 	}
+
+	CullTriangles(mesh, m_StripTriangles);
 }
 void Renderer::TriangleList(const Mesh& mesh)
 {
-	for (size_t i = 0; i < mesh.indices.size() - 2; i += 3)
-	{
-		const size_t v0 = mesh.indices[i];
-		const size_t v1 = mesh.indices[i + 1];
-		const size_t v2 = mesh.indices[i + 2];
-		Rasterize(mesh, v0, v1, v2);
-	}
+	CullTriangles(mesh, mesh.indices);
 }
 
-void Renderer::Rasterize(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2)
+void Renderer::CullTriangles(const Mesh& mesh, const std::vector<uint32_t>& triangles)
 {
-	const Vector2 V0 = { mesh.vertices_out[v0].position.x, mesh.vertices_out[v0].position.y };
-	const Vector2 V1 = { mesh.vertices_out[v1].position.x, mesh.vertices_out[v1].position.y };
-	const Vector2 V2 = { mesh.vertices_out[v2].position.x, mesh.vertices_out[v2].position.y };
+	const size_t triangleCount{ triangles.size() / 3 };
+	size_t triangle{ 0 };
+
+#if defined(__AVX2__)
+	//8 triangles at a time, their vertices gathered straight out of the vertex streams
+	const __m256i vertexStride{ _mm256_set1_epi32(sizeof(Vector4) / sizeof(float)) };
+	const __m256i cornerOffsets{ _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21) };
+	const float* pPositions{ &mesh.vertices_out.positions.data()->x };
+	const int* pOutcodes{ reinterpret_cast<const int*>(mesh.outcodes.data()) };
+	const __m256 subPixelScale{ _mm256_set1_ps(static_cast<float>(SubPixelScale)) };
+
+	for (; triangle + 8 <= triangleCount; triangle += 8)
+	{
+		const int* pCorners{ reinterpret_cast<const int*>(triangles.data() + triangle * 3) };
+		const __m256i v0{ _mm256_i32gather_epi32(pCorners, cornerOffsets, 4) };
+		const __m256i v1{ _mm256_i32gather_epi32(pCorners + 1, cornerOffsets, 4) };
+		const __m256i v2{ _mm256_i32gather_epi32(pCorners + 2, cornerOffsets, 4) };
+
+		const __m256i outcode0{ _mm256_i32gather_epi32(pOutcodes, v0, 4) };
+		const __m256i outcode1{ _mm256_i32gather_epi32(pOutcodes, v1, 4) };
+		const __m256i outcode2{ _mm256_i32gather_epi32(pOutcodes, v2, 4) };
+		const __m256i outsideAll{ _mm256_and_si256(_mm256_and_si256(outcode0, outcode1), outcode2) };
+		const __m256i planesToClip{ _mm256_and_si256(_mm256_or_si256(_mm256_or_si256(outcode0, outcode1), outcode2), _mm256_set1_epi32(ClipPlanes)) };
+
+		//snapped like Rasterize does, the differences are exact in float and their products in double,
+		//so the sign of the area is the same one the rasterizer would compute
+		const auto gatherSnapped{ [&](const __m256i& vertex, int component)
+			{
+				const __m256 coordinate{ _mm256_i32gather_ps(pPositions + component, _mm256_mullo_epi32(vertex, vertexStride), 4) };
+				return _mm256_round_ps(_mm256_mul_ps(coordinate, subPixelScale), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			} };
+		const __m256 X0{ gatherSnapped(v0, 0) }, Y0{ gatherSnapped(v0, 1) };
+		const __m256 X1{ gatherSnapped(v1, 0) }, Y1{ gatherSnapped(v1, 1) };
+		const __m256 X2{ gatherSnapped(v2, 0) }, Y2{ gatherSnapped(v2, 1) };
+		const __m256 edge1X{ _mm256_sub_ps(X1, X0) }, edge1Y{ _mm256_sub_ps(Y1, Y0) };
+		const __m256 edge2X{ _mm256_sub_ps(X2, X0) }, edge2Y{ _mm256_sub_ps(Y2, Y0) };
+
+		int positiveMask{ 0 }, zeroMask{ 0 };
+		for (int half = 0; half < 2; ++half)
+		{
+			const auto toDouble{ [half](const __m256& value) { return _mm256_cvtps_pd(half == 0 ? _mm256_castps256_ps128(value) : _mm256_extractf128_ps(value, 1)); } };
+			const __m256d area{ _mm256_sub_pd(
+				_mm256_mul_pd(toDouble(edge1X), toDouble(edge2Y)),
+				_mm256_mul_pd(toDouble(edge1Y), toDouble(edge2X))) };
+			positiveMask |= _mm256_movemask_pd(_mm256_cmp_pd(area, _mm256_setzero_pd(), _CMP_GT_OQ)) << (half * 4);
+			zeroMask |= _mm256_movemask_pd(_mm256_cmp_pd(area, _mm256_setzero_pd(), _CMP_EQ_OQ)) << (half * 4);
+		}
+
+		//off screen goes first, triangles that need clipping get their area test in ClipTriangle
+		const int offScreenMask{ ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(outsideAll, _mm256_setzero_si256()))) & 0xFF };
+		const int clipMask{ ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(planesToClip, _mm256_setzero_si256()))) & 0xFF };
+		const int candidateMask{ ~offScreenMask & ~clipMask & 0xFF };
+		const int zeroAreaMask{ candidateMask & zeroMask };
+		const int backFacingMask{ candidateMask & ~zeroMask & ~positiveMask };
 
-	const float w0 = mesh.vertices_out[v0].position.w;
-	const float w1 = mesh.vertices_out[v1].position.w;
-	const float w2 = mesh.vertices_out[v2].position.w;
+		m_CullStatistics.offScreen += std::popcount(static_cast<unsigned>(offScreenMask));
+		m_CullStatistics.zeroArea += std::popcount(static_cast<unsigned>(zeroAreaMask));
+		m_CullStatistics.backFacing += std::popcount(static_cast<unsigned>(backFacingMask));
 
-	//dont know if this should be here but it fixes a chrash
-	if(w0 < 0 || w1 < 0 || w2 < 0) return;
+		int keepMask{ ~(offScreenMask | zeroAreaMask | backFacingMask) & 0xFF };
+		while (keepMask != 0)
+		{
+			const int lane{ std::countr_zero(static_cast<unsigned>(keepMask)) };
+			keepMask &= keepMask - 1;
+
+			const size_t corner{ (triangle + lane) * 3 };
+			BinTriangle(mesh, triangles[corner], triangles[corner + 1], triangles[corner + 2]);
+		}
+	}
+#endif
+
+	for (; triangle < triangleCount; ++triangle)
+	{
+		const uint32_t v0{ triangles[triangle * 3] };
+		const uint32_t v1{ triangles[triangle * 3 + 1] };
+		const uint32_t v2{ triangles[triangle * 3 + 2] };
 
-	const BoundaryBox boundaryBox{
+		//all three outside the same plane, nothing of it can be visible
+		if (mesh.outcodes[v0] & mesh.outcodes[v1] & mesh.outcodes[v2])
 		{
-			std::clamp(std::min({V0.x, V1.x, V2.x}), 0.0f, static_cast<float>(m_Width - 1)),
-			std::clamp(std::min({V0.y, V1.y, V2.y}), 0.0f, static_cast<float>(m_Height - 1))
-		},
+			++m_CullStatistics.offScreen;
+			continue;
+		}
+
+		if (((mesh.outcodes[v0] | mesh.outcodes[v1] | mesh.outcodes[v2]) & ClipPlanes) == 0)
 		{
-			std::clamp(std::max({V0.x, V1.x, V2.x}), 0.0f, static_cast<float>(m_Width - 1)),
-			std::clamp(std::max({V0.y, V1.y, V2.y}), 0.0f, static_cast<float>(m_Height - 1))
+			const Vector4& P0 = mesh.vertices_out.positions[v0];
+			const Vector4& P1 = mesh.vertices_out.positions[v1];
+			const Vector4& P2 = mesh.vertices_out.positions[v2];
+			const int64_t area{ (SnapToSubPixel(P1.x) - SnapToSubPixel(P0.x)) * (SnapToSubPixel(P2.y) - SnapToSubPixel(P0.y))
+				- (SnapToSubPixel(P1.y) - SnapToSubPixel(P0.y)) * (SnapToSubPixel(P2.x) - SnapToSubPixel(P0.x)) };
+
+			if (area == 0)
+			{
+				++m_CullStatistics.zeroArea;
+				continue;
+			}
+			if (area < 0)
+			{
+				++m_CullStatistics.backFacing;
+				continue;
+			}
 		}
-	};
 
-	for (int py = boundaryBox.Smallest.y; py <= boundaryBox.Biggest.y; ++py)
+		BinTriangle(mesh, v0, v1, v2);
+	}
+}
+
+void Renderer::BinTriangle(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2)
+{
+	//crossing the side planes is fine as long as it stays inside the guard band, the tiles cut those off for free
+	const uint32_t planesToClip{ (mesh.outcodes[v0] | mesh.outcodes[v1] | mesh.outcodes[v2]) & ClipPlanes };
+	if (planesToClip == 0)
 	{
-		for (int px = boundaryBox.Smallest.x; px <= boundaryBox.Biggest.x; ++px)
+		if (!AddTriangle(&mesh.vertices_out, static_cast<uint32_t>(v0), static_cast<uint32_t>(v1), static_cast<uint32_t>(v2), &mesh.material))
+			++m_CullStatistics.offScreen;
+		return;
+	}
+
+	ClipTriangle(mesh, v0, v1, v2, planesToClip);
+}
+
+uint32_t Renderer::GetOutcode(const Vector4& position)
+{
+	uint32_t outcode{ 0 };
+	if (position.x < -position.w) outcode |= OutsideLeft;
+	if (position.x > position.w) outcode |= OutsideRight;
+	if (position.y < -position.w) outcode |= OutsideBottom;
+	if (position.y > position.w) outcode |= OutsideTop;
+	if (position.z < NearPlaneOffset * position.w) outcode |= OutsideNear;
+	if (position.z > position.w) outcode |= OutsideFar;
+	if (position.x < -GuardBand * position.w) outcode |= OutsideGuardLeft;
+	if (position.x > GuardBand * position.w) outcode |= OutsideGuardRight;
+	if (position.y < -GuardBand * position.w) outcode |= OutsideGuardBottom;
+	if (position.y > GuardBand * position.w) outcode |= OutsideGuardTop;
+	return outcode;
+}
+
+int64_t Renderer::SnapToSubPixel(float coordinate)
+{
+	//rounds half to even like the vectorized culling does
+	return static_cast<int64_t>(std::nearbyint(coordinate * SubPixelScale));
+}
+
+void Renderer::ClipTriangle(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2, uint32_t planesToClip)
+{
+	//signed distance to a clipping plane in clip space, inside when it isn't negative
+	const auto getDistance{ [](const Vector4& position, uint32_t plane)
+		{
+			switch (plane)
+			{
+			case OutsideNear: return position.z - NearPlaneOffset * position.w;
+			case OutsideGuardLeft: return position.x + GuardBand * position.w;
+			case OutsideGuardRight: return GuardBand * position.w - position.x;
+			case OutsideGuardBottom: return position.y + GuardBand * position.w;
+			default: return GuardBand * position.w - position.y;
+			}
+		} };
+
+	const auto lerpVertex{ [](const Vertex_Out& from, const Vertex_Out& to, float factor)
 		{
-			// Calculate the pixel center point in screen space
-			const Vector2 P(px + 0.5f, py + 0.5f);
-
-			// Calculate sub-areas for barycentric coordinates
-			float W0 = Vector2::Cross(V2 - V1, P - V1); // Opposite V0
-			if (W0 <= 0) continue;
-			float W1 = Vector2::Cross(V0 - V2, P - V2); // Opposite V1
-			if (W1 <= 0) continue;
-			float W2 = Vector2::Cross(V1 - V0, P - V0); // Opposite V2
-			if (W2 <= 0) continue;
-			
-			const float totalArea = W0 + W1 + W2;
-			const Vector3 weights
+			return Vertex_Out
 			{
-				W0 / totalArea,
-				W1 / totalArea,
-				W2 / totalArea
+				from.position + (to.position - from.position) * factor,
+				ColorRGB::Lerp(from.color, to.color, factor),
+				from.uv + (to.uv - from.uv) * factor,
+				from.normal + (to.normal - from.normal) * factor,
+				from.tangent + (to.tangent - from.tangent) * factor,
+				from.viewDirection + (to.viewDirection - from.viewDirection) * factor
 			};
+		} };
 
-			//get the depth of triangle
-			const float nonlinearDepth = 1.0f / (
-				weights.x / (1.f / mesh.vertices_out[v0].position.z) +
-				weights.y / (1.f / mesh.vertices_out[v1].position.z) +
-				weights.z / (1.f / mesh.vertices_out[v2].position.z) );
+	//the polygon works on clip space positions, every plane adds at most one vertex
+	Vertex_Out polygon[MaxClippedVertices]{ mesh.vertices_out.Get(v0), mesh.vertices_out.Get(v1), mesh.vertices_out.Get(v2) };
+	polygon[0].position = mesh.clipPositions[v0];
+	polygon[1].position = mesh.clipPositions[v1];
+	polygon[2].position = mesh.clipPositions[v2];
+	int vertexCount{ 3 };
 
-			//get the index where in screen this pixel is
-			const int pixelIndex = px + py * m_Width;
+	while (planesToClip != 0)
+	{
+		const uint32_t plane{ planesToClip & (~planesToClip + 1) };
+		planesToClip &= planesToClip - 1;
 
-			if(nonlinearDepth < 0 || nonlinearDepth > 1)
-				continue;
+		Vertex_Out clipped[MaxClippedVertices]{};
+		int clippedCount{ 0 };
+		for (int i = 0; i < vertexCount; ++i)
+		{
+			const Vertex_Out& current{ polygon[i] };
+			const Vertex_Out& next{ polygon[(i + 1) % vertexCount] };
+			const float currentDistance{ getDistance(current.position, plane) };
+			const float nextDistance{ getDistance(next.position, plane) };
+
+			if (currentDistance >= 0.f)
+				clipped[clippedCount++] = current;
+			if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+				clipped[clippedCount++] = lerpVertex(current, next, currentDistance / (currentDistance - nextDistance));
+		}
 
-			if (nonlinearDepth < m_pDepthBufferPixels[pixelIndex])
-			{
-				m_pDepthBufferPixels[pixelIndex] = nonlinearDepth;
+		if (clippedCount < 3)
+		{
+			++m_CullStatistics.offScreen;
+			return;
+		}
+
+		std::copy_n(clipped, clippedCount, polygon);
+		vertexCount = clippedCount;
+	}
+
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		ToScreenSpace(polygon[i].position);
+	}
+
+	//the same area test CullTriangles does, on the snapped fan the rasterizer is going to see
+	int64_t area{ 0 };
+	const int64_t X0{ SnapToSubPixel(polygon[0].position.x) }, Y0{ SnapToSubPixel(polygon[0].position.y) };
+	for (int i = 1; i < vertexCount - 1; ++i)
+	{
+		area += (SnapToSubPixel(polygon[i].position.x) - X0) * (SnapToSubPixel(polygon[i + 1].position.y) - Y0)
+			- (SnapToSubPixel(polygon[i].position.y) - Y0) * (SnapToSubPixel(polygon[i + 1].position.x) - X0);
+	}
+	if (area == 0)
+	{
+		++m_CullStatistics.zeroArea;
+		return;
+	}
+	if (area < 0)
+	{
+		++m_CullStatistics.backFacing;
+		return;
+	}
+
+	//the new vertices have to live until the tiles are rasterized, triangles point at them by index
+	const uint32_t firstVertex{ static_cast<uint32_t>(m_ClippedVertices.Size()) };
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		m_ClippedVertices.PushBack(polygon[i]);
+	}
+
+	//the polygon is convex and keeps the winding of the triangle, so a fan covers it
+	bool isBinned{ false };
+	for (uint32_t i = 1; i < static_cast<uint32_t>(vertexCount) - 1; ++i)
+	{
+		isBinned |= AddTriangle(&m_ClippedVertices, firstVertex, firstVertex + i, firstVertex + i + 1, &mesh.material);
+	}
+	if (!isBinned)
+		++m_CullStatistics.offScreen;
+}
+
+bool Renderer::AddTriangle(const VertexStreams* pVertices, uint32_t v0, uint32_t v1, uint32_t v2, const Material* pMaterial)
+{
+	const Vector4& P0 = pVertices->positions[v0];
+	const Vector4& P1 = pVertices->positions[v1];
+	const Vector4& P2 = pVertices->positions[v2];
+
+	const float minX{ std::min({ P0.x, P1.x, P2.x }) };
+	const float minY{ std::min({ P0.y, P1.y, P2.y }) };
+	const float maxX{ std::max({ P0.x, P1.x, P2.x }) };
+	const float maxY{ std::max({ P0.y, P1.y, P2.y }) };
+
+	//no pixel center can be inside, centers run from 0.5 to the size minus 0.5
+	if (maxX < 0.5f || maxY < 0.5f || minX > static_cast<float>(m_Width) - 0.5f || minY > static_cast<float>(m_Height) - 0.5f)
+		return false;
+
+	const int firstTileX{ static_cast<int>(std::max(minX, 0.f)) / TileSize };
+	const int firstTileY{ static_cast<int>(std::max(minY, 0.f)) / TileSize };
+	const int lastTileX{ static_cast<int>(std::min(maxX, static_cast<float>(m_Width - 1))) / TileSize };
+	const int lastTileY{ static_cast<int>(std::min(maxY, static_cast<float>(m_Height - 1))) / TileSize };
+
+	const uint32_t triangleIndex{ static_cast<uint32_t>(m_Triangles.size()) };
+	m_Triangles.push_back({ pVertices, { v0, v1, v2 }, pMaterial });
+
+	for (int tileY = firstTileY; tileY <= lastTileY; ++tileY)
+	{
+		for (int tileX = firstTileX; tileX <= lastTileX; ++tileX)
+		{
+			m_TileBins[tileX + tileY * m_TileCountX].push_back(triangleIndex);
+		}
+	}
+	return true;
+}
+
+void Renderer::RasterizeTile(uint32_t tileIndex)
+{
+	const int tileMinX{ static_cast<int>(tileIndex) % m_TileCountX * TileSize };
+	const int tileMinY{ static_cast<int>(tileIndex) / m_TileCountX * TileSize };
+	const int tileMaxX{ std::min(tileMinX + TileSize, m_Width) - 1 };
+	const int tileMaxY{ std::min(tileMinY + TileSize, m_Height) - 1 };
+
+	//fill the depth buffer with max values so it can become smaller and clear the screen buffer
+	const uint32_t clearColor{ SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100) };
+	for (int py = tileMinY; py <= tileMaxY; ++py)
+	{
+		std::fill_n(m_pDepthBufferPixels + tileMinX + py * m_Width, tileMaxX - tileMinX + 1, std::numeric_limits<float>::max());
+		std::fill_n(m_pBackBufferPixels + tileMinX + py * m_Width, tileMaxX - tileMinX + 1, clearColor);
+	}
+
+	//tiles are a multiple of the hierarchical z blocks, so those belong to one tile too
+	for (int blockY = tileMinY / HiZBlockSize; blockY <= tileMaxY / HiZBlockSize; ++blockY)
+	{
+		std::fill_n(m_HiZ.begin() + tileMinX / HiZBlockSize + blockY * m_HiZWidth, tileMaxX / HiZBlockSize - tileMinX / HiZBlockSize + 1, std::numeric_limits<float>::max());
+	}
 
-				const Vector2 uv0 = mesh.vertices_out[v0].uv;
-				const Vector2 uv1 = mesh.vertices_out[v1].uv;
-				const Vector2 uv2 = mesh.vertices_out[v2].uv;
+	if (m_VisibilityBufferActive)
+	{
+		for (int py = tileMinY; py <= tileMaxY; ++py)
+		{
+			std::fill_n(m_pVisibilityBuffer + tileMinX + py * m_Width, tileMaxX - tileMinX + 1, VisibilitySample{ VisibilitySample::NoTriangle });
+		}
+	}
+
+	for (uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		Rasterize(triangleIndex, tileMinX, tileMinY, tileMaxX, tileMaxY);
+	}
+
+	//with the visibility buffer the tile is only shaded once all of its triangles are rasterized,
+	//so every pixel is shaded once for the triangle that ended up in front
+	if (m_VisibilityBufferActive)
+		ShadeTile(tileMinX, tileMinY, tileMaxX, tileMaxY);
+}
+
+void Renderer::ShadeTile(int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+	for (int py = tileMinY; py <= tileMaxY; ++py)
+	{
+		for (int px = tileMinX; px <= tileMaxX; ++px)
+		{
+			const int pixelIndex{ px + py * m_Width };
+			const VisibilitySample& sample{ m_pVisibilityBuffer[pixelIndex] };
+			if (sample.triangleIndex == VisibilitySample::NoTriangle)
+				continue;
 
-				const float linearDepth = 1.0f / (
-					weights.x / w0 +
-					weights.y / w1 +
-					weights.z / w2 );
+			//the weights add up to one, so only two are stored
+			const Vector3 weights{ sample.weights.x, sample.weights.y, 1.f - sample.weights.x - sample.weights.y };
+			ShadePixel(m_Triangles[sample.triangleIndex], weights, m_pDepthBufferPixels[pixelIndex], pixelIndex);
+		}
+	}
+}
 
-				const Vector2 interpolatedUV = linearDepth * (
-					uv0 / w0 * weights.x +
-					uv1 / w1 * weights.y +
-					uv2 / w2 * weights.z );
+void Renderer::Rasterize(uint32_t triangleIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+	const RasterTriangle& triangle = m_Triangles[triangleIndex];
+	const Vector4& position0 = triangle.pVertices->positions[triangle.indices[0]];
+	const Vector4& position1 = triangle.pVertices->positions[triangle.indices[1]];
+	const Vector4& position2 = triangle.pVertices->positions[triangle.indices[2]];
+
+	//snapped to the sub-pixel grid, so two triangles sharing an edge get exactly opposite edge functions
+	const int64_t X0{ SnapToSubPixel(position0.x) }, Y0{ SnapToSubPixel(position0.y) };
+	const int64_t X1{ SnapToSubPixel(position1.x) }, Y1{ SnapToSubPixel(position1.y) };
+	const int64_t X2{ SnapToSubPixel(position2.x) }, Y2{ SnapToSubPixel(position2.y) };
+
+	//twice the area, back facing and zero area triangles have no pixel center inside
+	const int64_t totalArea{ (X2 - X1) * (Y0 - Y1) - (Y2 - Y1) * (X0 - X1) };
+	if (totalArea <= 0)
+		return;
+
+	//only the pixel centers inside the bounding box and this tile
+	constexpr int64_t halfPixel{ SubPixelScale / 2 };
+	const int minPixelX{ static_cast<int>(std::max<int64_t>(tileMinX, (std::min({ X0, X1, X2 }) - halfPixel + SubPixelScale - 1) >> SubPixelBits)) };
+	const int minPixelY{ static_cast<int>(std::max<int64_t>(tileMinY, (std::min({ Y0, Y1, Y2 }) - halfPixel + SubPixelScale - 1) >> SubPixelBits)) };
+	const int maxPixelX{ static_cast<int>(std::min<int64_t>(tileMaxX, (std::max({ X0, X1, X2 }) - halfPixel) >> SubPixelBits)) };
+	const int maxPixelY{ static_cast<int>(std::min<int64_t>(tileMaxY, (std::max({ Y0, Y1, Y2 }) - halfPixel) >> SubPixelBits)) };
+
+	//Edge function of a to b at the first pixel center, stepped with adds only after that.
+	//Top-left fill rule: a pixel center exactly on an edge only belongs to the triangle when it is a top or left edge,
+	//every other edge is pulled in by one so 0 fails the test
+	const int64_t startX{ (static_cast<int64_t>(minPixelX) << SubPixelBits) + halfPixel };
+	const int64_t startY{ (static_cast<int64_t>(minPixelY) << SubPixelBits) + halfPixel };
+	const auto setupEdge{ [&](int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t& value, int64_t& stepX, int64_t& stepY, int64_t& bias)
+		{
+			const int64_t dx{ bx - ax };
+			const int64_t dy{ by - ay };
+			const bool isTopLeft{ dy < 0 || (dy == 0 && dx > 0) };
+			bias = isTopLeft ? 0 : -1;
+			value = dx * (startY - ay) - dy * (startX - ax) + bias;
+			stepX = -dy * SubPixelScale;
+			stepY = dx * SubPixelScale;
+		} };
+
+	int64_t startW0, stepX0, stepY0, bias0; // Opposite V0
+	int64_t startW1, stepX1, stepY1, bias1; // Opposite V1
+	int64_t startW2, stepX2, stepY2, bias2; // Opposite V2
+	setupEdge(X1, Y1, X2, Y2, startW0, stepX0, stepY0, bias0);
+	setupEdge(X2, Y2, X0, Y0, startW1, stepX1, stepY1, bias1);
+	setupEdge(X0, Y0, X1, Y1, startW2, stepX2, stepY2, bias2);
+
+	const float inverseArea{ 1.f / static_cast<float>(totalArea) };
+
+	//the vertices keep 1 / depth, the depth of a pixel is one over the interpolated value
+	const float inverseDepth0{ position0.z };
+	const float inverseDepth1{ position1.z };
+	const float inverseDepth2{ position2.z };
+
+	//every pixel depth lies between the vertex depths, the triangle can't come closer than its nearest vertex
+	const float nearestDepth{ std::min({ inverseDepth0, inverseDepth1, inverseDepth2 }) > 0.f ? 1.f / std::max({ inverseDepth0, inverseDepth1, inverseDepth2 }) : 0.f };
+
+#if defined(__AVX2__)
+	//Spans of 8 pixels, lane i is i pixels right of the span start. The coverage test stays exact in 64 bit lanes
+	//(two registers per edge), the barycentric weights are only needed in float.
+	const auto laneSteps{ [](int64_t stepX, __m256i& low, __m256i& high)
+		{
+			low = _mm256_setr_epi64x(0, stepX, 2 * stepX, 3 * stepX);
+			high = _mm256_add_epi64(low, _mm256_set1_epi64x(4 * stepX));
+		} };
+	__m256i laneStep0Low, laneStep0High, laneStep1Low, laneStep1High, laneStep2Low, laneStep2High;
+	laneSteps(stepX0, laneStep0Low, laneStep0High);
+	laneSteps(stepX1, laneStep1Low, laneStep1High);
+	laneSteps(stepX2, laneStep2Low, laneStep2High);
+
+	const __m256 laneIndices{ _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f) };
+	const __m256 laneWeightStep0{ _mm256_mul_ps(laneIndices, _mm256_set1_ps(static_cast<float>(stepX0) * inverseArea)) };
+	const __m256 laneWeightStep1{ _mm256_mul_ps(laneIndices, _mm256_set1_ps(static_cast<float>(stepX1) * inverseArea)) };
+	const __m256 laneWeightStep2{ _mm256_mul_ps(laneIndices, _mm256_set1_ps(static_cast<float>(stepX2) * inverseArea)) };
+	const __m256i laneNumbers{ _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) };
+#endif
+
+	if (minPixelX > maxPixelX || minPixelY > maxPixelY)
+		return;
+
+	//The bounding box is walked in the 8x8 blocks of the hierarchical z buffer, a block is skipped as a whole when
+	//everything in it is already closer than the triangle or when one edge has the whole block outside
+	const int firstBlockX{ minPixelX / HiZBlockSize };
+	const int firstBlockY{ minPixelY / HiZBlockSize };
+	const int lastBlockX{ maxPixelX / HiZBlockSize };
+	const int lastBlockY{ maxPixelY / HiZBlockSize };
+
+	for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY)
+	{
+		const int blockMinY{ std::max(blockY * HiZBlockSize, minPixelY) };
+		const int blockMaxY{ std::min(blockY * HiZBlockSize + HiZBlockSize - 1, maxPixelY) };
 
-				const Vector3 InterpolatedNormal = linearDepth * (
-					mesh.vertices_out[v0].normal / w0 * weights.x +
-					mesh.vertices_out[v1].normal / w1 * weights.y +
-					mesh.vertices_out[v2].normal / w2 * weights.z );
+		for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX)
+		{
+			const int hiZIndex{ blockX + blockY * m_HiZWidth };
+			if (nearestDepth >= m_HiZ[hiZIndex])
+				continue;
 
-				const Vector3 InterpolatedTangent = linearDepth * (
-					mesh.vertices_out[v0].tangent / w0 * weights.x +
-					mesh.vertices_out[v1].tangent / w1 * weights.y +
-					mesh.vertices_out[v2].tangent / w2 * weights.z );
+			const int blockMinX{ std::max(blockX * HiZBlockSize, minPixelX) };
+			const int blockMaxX{ std::min(blockX * HiZBlockSize + HiZBlockSize - 1, maxPixelX) };
 
-				const Vector3 InterpolatedViewDirection = linearDepth * (
-					mesh.vertices_out[v0].viewDirection / w0 * weights.x +
-					mesh.vertices_out[v1].viewDirection / w1 * weights.y +
-					mesh.vertices_out[v2].viewDirection / w2 * weights.z );
+			//edge functions at the first pixel center of the block, the largest value of an edge is at one of the corners
+			const int64_t offsetX{ blockMinX - minPixelX };
+			const int64_t offsetY{ blockMinY - minPixelY };
+			const auto isBlockOutside{ [&](int64_t blockW, int64_t stepX, int64_t stepY)
+				{
+					return blockW + std::max<int64_t>(0, (blockMaxX - blockMinX) * stepX) + std::max<int64_t>(0, (blockMaxY - blockMinY) * stepY) < 0;
+				} };
 
-				const float remappedDepth = std::clamp(Remap(nonlinearDepth, 0.985f, 1.0f), 0.0f, 1.0f);
-				const ColorRGB InterpolatedColor = { remappedDepth, remappedDepth, remappedDepth };
+			int64_t rowW0{ startW0 + offsetX * stepX0 + offsetY * stepY0 };
+			int64_t rowW1{ startW1 + offsetX * stepX1 + offsetY * stepY1 };
+			int64_t rowW2{ startW2 + offsetX * stepX2 + offsetY * stepY2 };
+			if (isBlockOutside(rowW0, stepX0, stepY0) || isBlockOutside(rowW1, stepX1, stepY1) || isBlockOutside(rowW2, stepX2, stepY2))
+				continue;
 
-				const Vertex_Out vertex
+			bool isDepthWritten{ false };
+			for (int py = blockMinY; py <= blockMaxY; ++py, rowW0 += stepY0, rowW1 += stepY1, rowW2 += stepY2)
+			{
+#if defined(__AVX2__)
+				//one row of the block is one span
+				const int px{ blockMinX };
+				const int64_t W0{ rowW0 }, W1{ rowW1 }, W2{ rowW2 };
+
+				//a lane is outside when one of its three edge functions is negative, the sign bits say which
+				const __m256i outsideLow{ _mm256_or_si256(_mm256_or_si256(
+					_mm256_add_epi64(_mm256_set1_epi64x(W0), laneStep0Low),
+					_mm256_add_epi64(_mm256_set1_epi64x(W1), laneStep1Low)),
+					_mm256_add_epi64(_mm256_set1_epi64x(W2), laneStep2Low)) };
+				const __m256i outsideHigh{ _mm256_or_si256(_mm256_or_si256(
+					_mm256_add_epi64(_mm256_set1_epi64x(W0), laneStep0High),
+					_mm256_add_epi64(_mm256_set1_epi64x(W1), laneStep1High)),
+					_mm256_add_epi64(_mm256_set1_epi64x(W2), laneStep2High)) };
+
+				//lanes past the block or bounding box don't count, they may be outside the screen buffer too
+				const int laneCount{ blockMaxX - px + 1 };
+				const __m256i laneMask{ _mm256_cmpgt_epi32(_mm256_set1_epi32(laneCount), laneNumbers) };
+				const int outsideMask{ _mm256_movemask_pd(_mm256_castsi256_pd(outsideLow)) | _mm256_movemask_pd(_mm256_castsi256_pd(outsideHigh)) << 4 };
+				const int coverageMask{ ~outsideMask & _mm256_movemask_ps(_mm256_castsi256_ps(laneMask)) };
+
+				//the whole span is outside the triangle
+				if (coverageMask == 0)
+					continue;
+
+				// Calculate barycentric coordinates, without the fill rule bias
+				const __m256 weights0{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(W0 - bias0) * inverseArea), laneWeightStep0) };
+				const __m256 weights1{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(W1 - bias1) * inverseArea), laneWeightStep1) };
+				const __m256 weights2{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(W2 - bias2) * inverseArea), laneWeightStep2) };
+
+				//get the depth of triangle
+				const __m256 nonlinearDepth{ _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(weights0, _mm256_set1_ps(inverseDepth0)),
+					_mm256_mul_ps(weights1, _mm256_set1_ps(inverseDepth1))),
+					_mm256_mul_ps(weights2, _mm256_set1_ps(inverseDepth2)))) };
+
+				const int pixelIndex{ px + py * m_Width };
+				const __m256 bufferDepth{ _mm256_maskload_ps(m_pDepthBufferPixels + pixelIndex, laneMask) };
+				const __m256 passesDepth{ _mm256_and_ps(_mm256_and_ps(
+					_mm256_cmp_ps(nonlinearDepth, _mm256_setzero_ps(), _CMP_GE_OQ),
+					_mm256_cmp_ps(nonlinearDepth, _mm256_set1_ps(1.f), _CMP_LE_OQ)),
+					_mm256_cmp_ps(nonlinearDepth, bufferDepth, _CMP_LT_OQ)) };
+
+				int visibleMask{ coverageMask & _mm256_movemask_ps(passesDepth) };
+				if (visibleMask == 0)
+					continue;
+
+				alignas(32) float laneWeights0[8], laneWeights1[8], laneWeights2[8], laneDepths[8];
+				_mm256_store_ps(laneWeights0, weights0);
+				_mm256_store_ps(laneWeights1, weights1);
+				_mm256_store_ps(laneWeights2, weights2);
+				_mm256_store_ps(laneDepths, nonlinearDepth);
+
+				isDepthWritten = true;
+				while (visibleMask != 0)
+				{
+					const int lane{ std::countr_zero(static_cast<unsigned>(visibleMask)) };
+					visibleMask &= visibleMask - 1;
+
+					m_pDepthBufferPixels[pixelIndex + lane] = laneDepths[lane];
+					if (m_VisibilityBufferActive)
+						m_pVisibilityBuffer[pixelIndex + lane] = { triangleIndex, { laneWeights0[lane], laneWeights1[lane] } };
+					else
+						ShadePixel(triangle, { laneWeights0[lane], laneWeights1[lane], laneWeights2[lane] }, laneDepths[lane], pixelIndex + lane);
+				}
+#else
+				int64_t W0{ rowW0 }, W1{ rowW1 }, W2{ rowW2 };
+				for (int px = blockMinX; px <= blockMaxX; ++px, W0 += stepX0, W1 += stepX1, W2 += stepX2)
 				{
-					{0,0,0,0},
-					InterpolatedColor,
-					interpolatedUV,
-					InterpolatedNormal,
-					InterpolatedTangent,
-					InterpolatedViewDirection
-				};
-
-				PixelShading(&mesh.material, pixelIndex, vertex);
+					//inside when none of the three is negative
+					if ((W0 | W1 | W2) < 0)
+						continue;
+
+					// Calculate barycentric coordinates, without the fill rule bias
+					const Vector3 weights
+					{
+						static_cast<float>(W0 - bias0) * inverseArea,
+						static_cast<float>(W1 - bias1) * inverseArea,
+						static_cast<float>(W2 - bias2) * inverseArea
+					};
+
+					//get the depth of triangle
+					const float nonlinearDepth = 1.0f / (weights.x * inverseDepth0 + weights.y * inverseDepth1 + weights.z * inverseDepth2);
+
+					//get the index where in screen this pixel is
+					const int pixelIndex = px + py * m_Width;
+
+					if(nonlinearDepth < 0 || nonlinearDepth > 1)
+						continue;
+
+					if (nonlinearDepth < m_pDepthBufferPixels[pixelIndex])
+					{
+						m_pDepthBufferPixels[pixelIndex] = nonlinearDepth;
+						isDepthWritten = true;
+						if (m_VisibilityBufferActive)
+							m_pVisibilityBuffer[pixelIndex] = { triangleIndex, { weights.x, weights.y } };
+						else
+							ShadePixel(triangle, weights, nonlinearDepth, pixelIndex);
+					}
+				}
+#endif
 			}
+
+			if (isDepthWritten)
+				UpdateHiZBlock(blockX, blockY);
 		}
 	}
 }
 
+void Renderer::UpdateHiZBlock(int blockX, int blockY)
+{
+	const int minX{ blockX * HiZBlockSize };
+	const int minY{ blockY * HiZBlockSize };
+	const int width{ std::min(minX + HiZBlockSize, m_Width) - minX };
+	const int maxY{ std::min(minY + HiZBlockSize, m_Height) - 1 };
+
+	float maxDepth{ 0.f };
+	for (int py = minY; py <= maxY; ++py)
+	{
+		const float* pRow{ m_pDepthBufferPixels + minX + py * m_Width };
+		maxDepth = std::max(maxDepth, *std::max_element(pRow, pRow + width));
+	}
+	m_HiZ[blockX + blockY * m_HiZWidth] = maxDepth;
+}
+
+void Renderer::ShadePixel(const RasterTriangle& triangle, const Vector3& weights, float nonlinearDepth, int pixelIndex)
+{
+	const VertexStreams& vertices = *triangle.pVertices;
+	const uint32_t index0 = triangle.indices[0];
+	const uint32_t index1 = triangle.indices[1];
+	const uint32_t index2 = triangle.indices[2];
+
+	const float w0 = vertices.positions[index0].w;
+	const float w1 = vertices.positions[index1].w;
+	const float w2 = vertices.positions[index2].w;
+
+	const Vector2 uv0 = vertices.uvs[index0];
+	const Vector2 uv1 = vertices.uvs[index1];
+	const Vector2 uv2 = vertices.uvs[index2];
+
+	const float linearDepth = 1.0f / (
+		weights.x / w0 +
+		weights.y / w1 +
+		weights.z / w2 );
+
+	const Vector2 interpolatedUV = linearDepth * (
+		uv0 / w0 * weights.x +
+		uv1 / w1 * weights.y +
+		uv2 / w2 * weights.z );
+
+	const Vector3 InterpolatedNormal = linearDepth * (
+		vertices.normals[index0] / w0 * weights.x +
+		vertices.normals[index1] / w1 * weights.y +
+		vertices.normals[index2] / w2 * weights.z );
+
+	const Vector3 InterpolatedTangent = linearDepth * (
+		vertices.tangents[index0] / w0 * weights.x +
+		vertices.tangents[index1] / w1 * weights.y +
+		vertices.tangents[index2] / w2 * weights.z );
+
+	const Vector3 InterpolatedViewDirection = linearDepth * (
+		vertices.viewDirections[index0] / w0 * weights.x +
+		vertices.viewDirections[index1] / w1 * weights.y +
+		vertices.viewDirections[index2] / w2 * weights.z );
+
+	const float remappedDepth = std::clamp(Remap(nonlinearDepth, 0.985f, 1.0f), 0.0f, 1.0f);
+	const ColorRGB InterpolatedColor = { remappedDepth, remappedDepth, remappedDepth };
+
+	const Vertex_Out vertex
+	{
+		{0,0,0,0},
+		InterpolatedColor,
+		interpolatedUV,
+		InterpolatedNormal,
+		InterpolatedTangent,
+		InterpolatedViewDirection
+	};
+
+	PixelShading(triangle.pMaterial, pixelIndex, vertex);
+}
+
 void Renderer::PixelShading(const Material* pMaterial, const int pixelIndex, const Vertex_Out& vertex_out) const
 {
 	Vector3 SampeldNormal { vertex_out.normal };
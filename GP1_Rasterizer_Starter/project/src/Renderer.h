@@ -60,18 +60,41 @@ namespace dae
 			else
 				std::cout << "Normals map off\n";
 		}
+		void ToggleVisibilityBuffer()
+		{
+			m_VisibilityBufferActive = !m_VisibilityBufferActive;
+			if (m_VisibilityBufferActive)
+				std::cout << "Visibility buffer on\n";
+			else
+				std::cout << "Visibility buffer off\n";
+		}
 		void CycleLightingMode();
 
+		const CullStatistics& GetCullStatistics() const { return m_CullStatistics; }
+
 	private:
 		void InitializeSpaceBike();
 
 		void RasterizeMesh(); 
 
 		void VertexTransformationFunction(Mesh& mesh) const;
+		void ToScreenSpace(Vector4& position) const;
+		static uint32_t GetOutcode(const Vector4& position);
+		static int64_t SnapToSubPixel(float coordinate);
 
 		void TriangleStrip(const Mesh& mesh);
 		void TriangleList(const Mesh& mesh);
-		void Rasterize(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2);
+		void CullTriangles(const Mesh& mesh, const std::vector<uint32_t>& triangles);
+		void BinTriangle(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2);
+		void ClipTriangle(const Mesh& mesh, const size_t v0, const size_t v1, const size_t v2, uint32_t planesToClip);
+		//false when no pixel center can be inside, the caller counts it so a clipped triangle counts once
+		bool AddTriangle(const VertexStreams* pVertices, uint32_t v0, uint32_t v1, uint32_t v2, const Material* pMaterial);
+
+		void RasterizeTile(uint32_t tileIndex);
+		void Rasterize(uint32_t triangleIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+		void ShadeTile(int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+		void ShadePixel(const RasterTriangle& triangle, const Vector3& weights, float nonlinearDepth, int pixelIndex);
+		void UpdateHiZBlock(int blockX, int blockY);
 
 		void PixelShading(const Material* pMaterial, const int pixelIndex, const Vertex_Out& vertex_out) const;
 
@@ -84,6 +107,52 @@ namespace dae
 		uint32_t* m_pBackBufferPixels{};
 
 		float* m_pDepthBufferPixels{};
+		//which triangle is visible in every pixel and where, shaded after the tile is rasterized
+		VisibilitySample* m_pVisibilityBuffer{};
+
+		//vertex positions are snapped to 1/16 of a pixel for the fixed point edge functions
+		static constexpr int SubPixelBits{ 4 };
+		static constexpr int64_t SubPixelScale{ 1 << SubPixelBits };
+
+		//outcode bits of the planes a clip space vertex can be outside of
+		static constexpr uint32_t OutsideLeft{ 1 << 0 };
+		static constexpr uint32_t OutsideRight{ 1 << 1 };
+		static constexpr uint32_t OutsideBottom{ 1 << 2 };
+		static constexpr uint32_t OutsideTop{ 1 << 3 };
+		static constexpr uint32_t OutsideNear{ 1 << 4 };
+		static constexpr uint32_t OutsideFar{ 1 << 5 };
+		static constexpr uint32_t OutsideGuardLeft{ 1 << 6 };
+		static constexpr uint32_t OutsideGuardRight{ 1 << 7 };
+		static constexpr uint32_t OutsideGuardBottom{ 1 << 8 };
+		static constexpr uint32_t OutsideGuardTop{ 1 << 9 };
+		//only these are really clipped, the others just reject triangles that are completely outside
+		static constexpr uint32_t ClipPlanes{ OutsideNear | OutsideGuardLeft | OutsideGuardRight | OutsideGuardBottom | OutsideGuardTop };
+		static constexpr int MaxClippedVertices{ 3 + 5 };
+
+		//how many half screens past the border a vertex may go before it gets clipped,
+		//keeps snapped coordinates far inside 64 bit products and float precision below a sub-pixel
+		static constexpr float GuardBand{ 64.f };
+		//the depth is interpolated as one over the ndc depth, which must not become zero on the near plane
+		static constexpr float NearPlaneOffset{ 1e-5f };
+
+		//Hierarchical z buffer, the farthest depth of every 8x8 block of the depth buffer
+		static constexpr int HiZBlockSize{ 8 };
+		int m_HiZWidth{};
+		std::vector<float> m_HiZ{};
+
+		//every tile owns its part of the color and depth buffer, so tiles rasterize in parallel without locks
+		static constexpr int TileSize{ 64 };
+		int m_TileCountX{};
+		int m_TileCountY{};
+		std::vector<uint32_t> m_TileIndices{};
+		//triangles of this frame and, per tile, the indices of the ones that touch it in submission order
+		std::vector<RasterTriangle> m_Triangles{};
+		std::vector<std::vector<uint32_t>> m_TileBins{};
+		//strip meshes unrolled into a triangle list for the culling stage
+		std::vector<uint32_t> m_StripTriangles{};
+		CullStatistics m_CullStatistics{};
+		//vertices made by clipping this frame
+		VertexStreams m_ClippedVertices{};
 
 		Matrix m_WorldSpace{};
 
@@ -114,5 +183,6 @@ namespace dae
 		bool m_ShouldRotated{ true };
 		bool m_NormalMapActive{ true };
 		bool m_DepthToggle{false};
+		bool m_VisibilityBufferActive{ true };
 	};
 }
@@ -4,23 +4,31 @@
 
 #include "Vector2.h"
 #include <SDL_image.h>
-#include <stdexcept>
+#include <SDL_surface.h>
 
 namespace dae
 {
 	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ static_cast<uint32_t*>(m_pSurface->pixels) }
+		m_Width{ pSurface->w },
+		m_Height{ pSurface->h },
+		m_BlocksPerRow{ (pSurface->w + BlockSize - 1) / BlockSize }
 	{
-	}
+		const int blockRows{ (m_Height + BlockSize - 1) / BlockSize };
+		m_Texels.resize(static_cast<size_t>(m_BlocksPerRow) * blockRows * BlockSize * BlockSize);
 
-	Texture::~Texture()
-	{
-		if (m_pSurface)
+		for (int y = 0; y < m_Height; ++y)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + static_cast<size_t>(y) * pSurface->pitch };
+			for (int x = 0; x < m_Width; ++x)
+			{
+				const uint8_t* pPixel{ pRow + x * 4 };
+				const size_t block{ static_cast<size_t>((x >> BlockShift) + (y >> BlockShift) * m_BlocksPerRow) };
+				m_Texels[(block << (2 * BlockShift)) + ((y & (BlockSize - 1)) << BlockShift) + (x & (BlockSize - 1))] =
+					pPixel[0] | pPixel[1] << 8 | pPixel[2] << 16 | static_cast<uint32_t>(pPixel[3]) << 24;
+			}
 		}
+
+		SDL_FreeSurface(pSurface);
 	}
 
 	Texture* Texture::LoadFromFile(const std::string& path)
@@ -32,21 +40,41 @@ namespace dae
 			return nullptr;
 		}
 
-		return new Texture(pSurface);
+		//whatever the file was, read it as r, g, b, a bytes
+		SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(pSurface);
+		if (!pConverted)
+		{
+			std::cout << "Texture could not be converted to RGBA: " + path + "\n";
+			return nullptr;
+		}
+
+		return new Texture(pConverted);
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		int texWidth = m_pSurface->w;
-		int texHeight = m_pSurface->h;
+		const float u = uv.x * (m_Width - 1);
+		const float v = uv.y * (m_Height - 1);
+		int x = static_cast<int>(u);
+		int y = static_cast<int>(v);
+
+		//rounded down instead of to zero, so negative coordinates wrap to the right texel
+		if (u < static_cast<float>(x)) --x;
+		if (v < static_cast<float>(y)) --y;
 
-		int x = static_cast<int>(uv.x * (texWidth - 1));
-		int y = static_cast<int>(uv.y * (texHeight - 1));
+		//wrap addressing, only pays for the modulo outside of [0, 1]
+		if (static_cast<unsigned>(x) >= static_cast<unsigned>(m_Width))
+			x = (x % m_Width + m_Width) % m_Width;
+		if (static_cast<unsigned>(y) >= static_cast<unsigned>(m_Height))
+			y = (y % m_Height + m_Height) % m_Height;
 
-		uint32_t pixelColor = m_pSurfacePixels[x + y * texWidth];
+		const int block{ (x >> BlockShift) + (y >> BlockShift) * m_BlocksPerRow };
+		const uint32_t texel{ m_Texels[(block << (2 * BlockShift)) + ((y & (BlockSize - 1)) << BlockShift) + (x & (BlockSize - 1))] };
 
-		uint8_t r,g,b;
-		SDL_GetRGB(pixelColor, m_pSurface->format, &r, &g, &b);
+		const uint8_t r{ static_cast<uint8_t>(texel) };
+		const uint8_t g{ static_cast<uint8_t>(texel >> 8) };
+		const uint8_t b{ static_cast<uint8_t>(texel >> 16) };
 
 		return ColorRGB{r / 255.f, g / 255.f, b / 255.f};
 	}
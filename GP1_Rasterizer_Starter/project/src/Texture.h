@@ -1,25 +1,36 @@
 #pragma once
-#include <memory>
-#include <SDL_surface.h>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
 
+struct SDL_Surface;
+
 namespace dae
 {
 	struct Vector2;
 
+	//Decoded once at load into RGBA8 texels, stored in 4x4 blocks so a block is one 64 byte cache line
+	//and texels that are close in uv are close in memory in both directions
 	class Texture
 	{
 	public:
-		~Texture();
+		~Texture() = default;
 
 		static Texture* LoadFromFile(const std::string& path);
 		ColorRGB Sample(const Vector2& uv) const;
 
 	private:
+		//decodes an RGBA32 surface and frees it
 		Texture(SDL_Surface* pSurface);
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		static constexpr int BlockShift{ 2 };
+		static constexpr int BlockSize{ 1 << BlockShift };
+
+		int m_Width{};
+		int m_Height{};
+		int m_BlocksPerRow{};
+		//r in the lowest byte, a in the highest
+		std::vector<uint32_t> m_Texels{};
 	};
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include <fstream>
+#include <unordered_map>
 #include "Maths.h"
 #include "DataTypes.h"
 
@@ -13,6 +14,125 @@ namespace dae
 		//Just parses vertices and indices
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
+		/**
+		 * \brief Reorders the triangles so the ones sharing vertices follow each other (Tipsify, Sander et al. 2007),
+		 * then renumbers the vertices in the order the triangles first use them. Transformed vertices are then
+		 * read back close to where they were written instead of all over the vertex buffer.
+		 * \param cacheSize How many recent vertices are expected to still be close at hand
+		 */
+		static void OptimizeVertexOrder(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int cacheSize = 32)
+		{
+			const int vertexCount{ static_cast<int>(vertices.size()) };
+			const int triangleCount{ static_cast<int>(indices.size() / 3) };
+
+			//triangles around every vertex, offsets into one flat list
+			std::vector<int> liveTriangles(vertexCount);
+			for (uint32_t index : indices)
+			{
+				++liveTriangles[index];
+			}
+			std::vector<int> adjacencyOffsets(vertexCount + 1);
+			for (int vertex = 0; vertex < vertexCount; ++vertex)
+			{
+				adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+			}
+			std::vector<int> adjacency(indices.size());
+			std::vector<int> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (int triangle = 0; triangle < triangleCount; ++triangle)
+			{
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					adjacency[fillOffsets[indices[triangle * 3 + corner]]++] = triangle;
+				}
+			}
+
+			std::vector<int> cacheTimes(vertexCount);
+			std::vector<bool> isEmitted(triangleCount);
+			std::vector<int> deadEnds{};
+			std::vector<int> candidates{};
+			std::vector<uint32_t> optimizedIndices{};
+			optimizedIndices.reserve(indices.size());
+
+			int time{ cacheSize + 1 };
+			int cursor{ 0 };
+			int fanVertex{ vertexCount > 0 ? 0 : -1 };
+			while (fanVertex >= 0)
+			{
+				//emit every triangle around the current vertex
+				candidates.clear();
+				for (int adjacent = adjacencyOffsets[fanVertex]; adjacent < adjacencyOffsets[fanVertex + 1]; ++adjacent)
+				{
+					const int triangle{ adjacency[adjacent] };
+					if (isEmitted[triangle])
+						continue;
+
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						const uint32_t vertex{ indices[triangle * 3 + corner] };
+						optimizedIndices.push_back(vertex);
+						deadEnds.push_back(vertex);
+						candidates.push_back(vertex);
+						--liveTriangles[vertex];
+						if (time - cacheTimes[vertex] > cacheSize)
+							cacheTimes[vertex] = time++;
+					}
+					isEmitted[triangle] = true;
+				}
+
+				//continue with the candidate that is still cached and has the most left to emit
+				int nextVertex{ -1 };
+				int bestPriority{ -1 };
+				for (int vertex : candidates)
+				{
+					if (liveTriangles[vertex] <= 0)
+						continue;
+
+					int priority{ 0 };
+					if (time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+						priority = time - cacheTimes[vertex];
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						nextVertex = vertex;
+					}
+				}
+
+				//dead end, go back to a recent vertex with triangles left or else the next one in input order
+				while (nextVertex < 0 && !deadEnds.empty())
+				{
+					const int vertex{ deadEnds.back() };
+					deadEnds.pop_back();
+					if (liveTriangles[vertex] > 0)
+						nextVertex = vertex;
+				}
+				while (nextVertex < 0 && cursor < vertexCount)
+				{
+					if (liveTriangles[cursor] > 0)
+						nextVertex = cursor;
+					++cursor;
+				}
+
+				fanVertex = nextVertex;
+			}
+
+			//number the vertices in order of first use
+			std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+			std::vector<Vertex> optimizedVertices{};
+			optimizedVertices.reserve(vertexCount);
+			for (uint32_t& index : optimizedIndices)
+			{
+				if (remap[index] == UINT32_MAX)
+				{
+					remap[index] = static_cast<uint32_t>(optimizedVertices.size());
+					optimizedVertices.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+
+			vertices = std::move(optimizedVertices);
+			indices = std::move(optimizedIndices);
+		}
+
 		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
 		{
 #ifdef DISABLE_OBJ
@@ -31,6 +151,24 @@ namespace dae
 			std::vector<Vector3> normals{};
 			std::vector<Vector2> UVs{};
 
+			//corners with the same position, uv and normal index become one vertex
+			struct CornerKey
+			{
+				size_t iPosition, iTexCoord, iNormal;
+				bool operator==(const CornerKey& other) const
+				{
+					return iPosition == other.iPosition && iTexCoord == other.iTexCoord && iNormal == other.iNormal;
+				}
+			};
+			struct CornerHash
+			{
+				size_t operator()(const CornerKey& key) const
+				{
+					return std::hash<size_t>{}((key.iPosition * 73856093) ^ (key.iTexCoord * 19349663) ^ (key.iNormal * 83492791));
+				}
+			};
+			std::unordered_map<CornerKey, uint32_t, CornerHash> cornerVertices{};
+
 			vertices.clear();
 			indices.clear();
 
@@ -76,12 +214,13 @@ namespace dae
 					//add the material index as attibute to the attribute array
 					//
 					// Faces or triangles
-					Vertex vertex{};
-					size_t iPosition, iTexCoord, iNormal;
-
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
+						Vertex vertex{};
+						//0 when the corner doesn't have one
+						size_t iPosition{}, iTexCoord{}, iNormal{};
+
 						// OBJ format uses 1-based arrays
 						file >> iPosition;
 						vertex.position = positions[iPosition - 1];
@@ -107,9 +246,10 @@ namespace dae
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
+						const auto [it, isNew] = cornerVertices.try_emplace({ iPosition, iTexCoord, iNormal }, uint32_t(vertices.size()));
+						if (isNew)
+							vertices.push_back(vertex);
+						tempIndices[iFace] = it->second;
 					}
 
 					indices.push_back(tempIndices[0]);
@@ -128,6 +268,8 @@ namespace dae
 				file.ignore(1000, '\n');
 			}
 
+			OptimizeVertexOrder(vertices, indices);
+
 			//Cheap Tangent Calculations
 			for (uint32_t i = 0; i < indices.size(); i += 3)
 			{
@@ -146,7 +288,13 @@ namespace dae
 				const Vector3 edge1 = p2 - p0;
 				const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
 				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
-				float r = 1.f / Vector2::Cross(diffX, diffY);
+
+				//no tangent when the uvs are (almost) on a line, welded neighbours would get its inf or NaN too
+				const float uvArea = Vector2::Cross(diffX, diffY);
+				if (std::abs(uvArea) <= 1e-6f * (uv1 - uv0).Magnitude() * (uv2 - uv0).Magnitude())
+					continue;
+
+				float r = 1.f / uvArea;
 
 				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
 				vertices[index0].tangent += tangent;
@@ -157,7 +305,12 @@ namespace dae
 			//Fix the tangents per vertex now because we accumulated
 			for (auto& v : vertices)
 			{
-				v.tangent = Vector3::Reject(v.tangent, v.normal).Normalized();
+				v.tangent = Vector3::Reject(v.tangent, v.normal);
+
+				//only touched by triangles without a tangent, any direction on the surface will do
+				if (v.tangent.SqrMagnitude() <= 0.f)
+					v.tangent = Vector3::Cross(v.normal, std::abs(v.normal.x) < 0.9f ? Vector3::UnitX : Vector3::UnitY);
+				v.tangent.Normalize();
 
 				if(flipAxisAndWinding)
 				{
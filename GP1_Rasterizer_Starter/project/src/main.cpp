@@ -77,6 +77,8 @@ int main(int argc, char* args[])
 					pRenderer->ToggleNormalMapping();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
 					pRenderer->CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->ToggleVisibilityBuffer();
 				break;
 			}
 		}
@@ -94,6 +96,9 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+
+			const CullStatistics& culled{ pRenderer->GetCullStatistics() };
+			std::cout << "Culled back facing: " << culled.backFacing << ", zero area: " << culled.zeroArea << ", off screen: " << culled.offScreen << std::endl;
 		}
 
 		//Save screenshot after full render
@@ -0,0 +1,95 @@
+#include "BatchRenderer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "ImageWriter.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+using namespace dae;
+
+BatchRenderer::BatchRenderer(const std::function<Scene*()>& createScene, const BatchSettings& settings) :
+	m_CreateScene(createScene),
+	m_Settings(settings)
+{
+}
+
+bool BatchRenderer::Run()
+{
+	//the frame count bounds the worker count and the frame rate divides the frame number
+	if (m_Settings.frameCount <= 0 || m_Settings.framesPerSecond <= 0.f)
+	{
+		std::cout << "Batch needs at least one frame and a positive frame rate" << std::endl;
+		return false;
+	}
+
+	Timer timer{};
+	timer.Start();
+
+	m_NextFrame = 0;
+
+	//one worker per core, each owns a scene and renderer so frames don't share any state
+	const int workerCount{ std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, m_Settings.frameCount) };
+
+	std::cout << "Rendering " << m_Settings.frameCount << " frames on " << workerCount << " threads" << std::endl;
+
+	{
+		//frames are encoded and written in the background while the workers keep rendering
+		ImageWriter imageWriter{};
+
+		std::vector<std::thread> workers{};
+		workers.reserve(workerCount);
+		for (int i = 0; i < workerCount; ++i)
+		{
+			workers.emplace_back(&BatchRenderer::RenderFrames, this, std::ref(imageWriter));
+		}
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	timer.Update();
+	std::cout << "Batch finished in " << timer.GetTotal() << " seconds" << std::endl;
+	return true;
+}
+
+void BatchRenderer::RenderFrames(ImageWriter& imageWriter)
+{
+	Scene* pScene{ m_CreateScene() };
+	pScene->Initialize();
+
+	Renderer* pRenderer{ new Renderer(m_Settings.width, m_Settings.height) };
+	if (m_Settings.samplesPerPixel > 0)
+		pRenderer->TogglePathTracing();
+
+	for (int frame = m_NextFrame++; frame < m_Settings.frameCount; frame = m_NextFrame++)
+	{
+		pScene->Animate(m_Settings.startTime + frame / m_Settings.framesPerSecond);
+
+		//every render after the first one adds a sample to the unchanged frame
+		for (int sample = 0; sample < std::max(1, m_Settings.samplesPerPixel); ++sample)
+		{
+			pRenderer->Render(pScene);
+		}
+
+		pRenderer->SaveBufferToImage(imageWriter, m_Settings.GetFileName(frame));
+	}
+
+	delete pRenderer;
+	delete pScene;
+}
+
+std::string BatchSettings::GetFileName(int frame) const
+{
+	std::ostringstream fileName{};
+	fileName << outputPrefix << std::setw(4) << std::setfill('0') << frame << ".png";
+	return fileName.str();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+
+namespace dae
+{
+	class ImageWriter;
+	class Scene;
+
+	struct BatchSettings
+	{
+		int frameCount{ 60 };
+		float framesPerSecond{ 30.f };
+		float startTime{ 0.f };
+
+		int width{ 640 };
+		int height{ 480 };
+
+		//0 renders direct lighting, more path traces and averages that many samples per pixel
+		int samplesPerPixel{ 0 };
+
+		std::string outputPrefix{ "RayTracing_Frame_" };
+
+		//outputPrefix followed by the zero padded frame number
+		std::string GetFileName(int frame) const;
+	};
+
+	//Offline animation rendering: the scene is evaluated at explicit timestamps instead of the wall clock Timer,
+	//every core renders a whole frame at once and writes it to a numbered image.
+	class BatchRenderer final
+	{
+	public:
+		BatchRenderer(const std::function<Scene*()>& createScene, const BatchSettings& settings);
+		~BatchRenderer() = default;
+
+		BatchRenderer(const BatchRenderer&) = delete;
+		BatchRenderer(BatchRenderer&&) noexcept = delete;
+		BatchRenderer& operator=(const BatchRenderer&) = delete;
+		BatchRenderer& operator=(BatchRenderer&&) noexcept = delete;
+
+		//blocks until every frame is written, false when the settings can't be rendered
+		bool Run();
+
+	private:
+		void RenderFrames(ImageWriter& imageWriter);
+
+		std::function<Scene*()> m_CreateScene{};
+		BatchSettings m_Settings{};
+
+		std::atomic<int> m_NextFrame{ 0 };
+	};
+}
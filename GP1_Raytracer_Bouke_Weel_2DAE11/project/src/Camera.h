@@ -28,12 +28,15 @@ namespace dae
 		float totalPitch{ 0.f };
 		float totalYaw{ 0.f };
 
-		const float MoveSpeedKey{5.f};
-		const float MoveSpeedMouse{ 0.01f };
-		const float RotatedSpeed{ 0.01f };
+		static constexpr float MoveSpeedKey{5.f};
+		static constexpr float MoveSpeedMouse{ 0.01f };
+		static constexpr float RotatedSpeed{ 0.01f };
 
 		Matrix cameraToWorld{};
 
+		//set whenever the camera moved or rotated, cleared by the renderer after a frame
+		bool isDirty{ true };
+
 
 		Matrix CalculateCameraToWorld()
 		{
@@ -54,6 +57,10 @@ namespace dae
 		{
 			const float deltaTime = pTimer->GetElapsed();
 
+			const Vector3 previousOrigin{ origin };
+			const float previousPitch{ totalPitch };
+			const float previousYaw{ totalYaw };
+
 			Vector3 InputVector{};
 
 			//Keyboard Input
@@ -113,6 +120,9 @@ namespace dae
 			InputVector = pitchYawRotation.TransformVector(InputVector);
 
 			origin += InputVector * deltaTime * MoveSpeedKey;
+
+			if (!(origin == previousOrigin) || totalPitch != previousPitch || totalYaw != previousYaw)
+				isDirty = true;
 		}
 	};
 }
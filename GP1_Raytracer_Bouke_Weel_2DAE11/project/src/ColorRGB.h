@@ -60,7 +60,7 @@ namespace dae
 			b /= c.b;
 			return *this;
 		}
-		const ColorRGB& operator/(const ColorRGB& c) const
+		ColorRGB operator/(const ColorRGB& c) const
 		{
 			return { r / c.r, g / c.g, b / c.b };
 		}
@@ -82,7 +82,7 @@ namespace dae
 			b /= s;
 			return *this;
 		}
-		const ColorRGB& operator/(float s) const
+		ColorRGB operator/(float s) const
 		{
 			return { r / s, g / s, b / s };
 		}
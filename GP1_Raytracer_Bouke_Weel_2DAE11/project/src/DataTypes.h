@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "Maths.h"
+#include "QuantizedBVH.h"
 
 
 namespace dae
@@ -94,19 +95,36 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
 
+		//meshes with a bvh are traced in object space and don't keep transformed copies
+		QuantizedBVH bvh{};
+		Matrix transform{};
+		Matrix inverseTransform{};
+
+		//set whenever a transform changed, cleared by the renderer after a frame
+		bool isDirty{ true };
+
 		void Translate(const Vector3& translation)
 		{
-			translationTransform = Matrix::CreateTranslation(translation);
+			SetTransform(translationTransform, Matrix::CreateTranslation(translation));
 		}
 
 		void RotateY(float yaw)
 		{
-			rotationTransform = Matrix::CreateRotationY(yaw);
+			SetTransform(rotationTransform, Matrix::CreateRotationY(yaw));
 		}
 
 		void Scale(const Vector3& scale)
 		{
-			scaleTransform = Matrix::CreateScale(scale);
+			SetTransform(scaleTransform, Matrix::CreateScale(scale));
+		}
+
+		void SetTransform(Matrix& transform, const Matrix& newTransform)
+		{
+			if (transform == newTransform)
+				return;
+
+			transform = newTransform;
+			isDirty = true;
 		}
 
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
@@ -148,11 +166,29 @@ namespace dae
 			}
 		}
 
+		//For big meshes, reorders the triangles into the tree
+		void BuildBVH()
+		{
+			bvh.Build(positions, indices, normals);
+			UpdateTransforms();
+		}
+
 		void UpdateTransforms()
 		{
 			//Calculate Final Transform 
 			const Matrix finalTransform{ scaleTransform * rotationTransform * translationTransform };
 
+			if (!bvh.IsEmpty())
+			{
+				transform = finalTransform;
+				inverseTransform = Matrix::Inverse(finalTransform);
+
+				transformedPositions = {};
+				transformedNormals = {};
+				UpdateTransformedAABB(finalTransform);
+				return;
+			}
+
 			transformedPositions.reserve(positions.size());
 			transformedNormals.reserve(normals.size());
 
@@ -240,7 +276,9 @@ namespace dae
 	enum class LightType
 	{
 		Point,
-		Directional
+		Directional,
+		Sphere,	//area light, origin is the center
+		Quad	//area light, origin is the center, emits to the side of direction
 	};
 
 	struct Light
@@ -250,6 +288,11 @@ namespace dae
 		ColorRGB color{};
 		float intensity{};
 
+		//area lights
+		float radius{};
+		Vector3 edge0{};
+		Vector3 edge1{};
+
 		LightType type{};
 	};
 #pragma endregion
@@ -271,6 +314,55 @@ namespace dae
 
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
+
+		//which object of the scene was hit and, for meshes, which triangle
+		int objectIndex{ -1 };
+		int primitiveIndex{ 0 };
+	};
+
+	//Pyramid of rays leaving the camera through a rectangle of the screen, bounded by four planes through the origin
+	struct Frustum
+	{
+		Vector3 origin{};
+		Vector3 normals[4]{};	//point into the frustum
+
+		//corners in order around the rectangle, either winding
+		void Build(const Vector3& cameraOrigin, const Vector3 corners[4])
+		{
+			origin = cameraOrigin;
+			const Vector3 center{ corners[0] + corners[1] + corners[2] + corners[3] };
+			for (int i = 0; i < 4; ++i)
+			{
+				normals[i] = Vector3::Cross(corners[i], corners[(i + 1) % 4]).Normalized();
+				if (Vector3::Dot(normals[i], center) < 0.f)
+					normals[i] = -normals[i];
+			}
+		}
+
+		//Conservative tests, the margin keeps rays that graze a side plane from missing an object
+		bool IsSphereVisible(const Vector3& center, float radius) const
+		{
+			for (const Vector3& normal : normals)
+			{
+				if (Vector3::Dot(normal, center - origin) < -(radius + Margin))
+					return false;
+			}
+			return true;
+		}
+
+		bool IsAABBVisible(const Vector3& minAABB, const Vector3& maxAABB) const
+		{
+			for (const Vector3& normal : normals)
+			{
+				//the corner furthest into the frustum
+				const Vector3 corner{ normal.x >= 0.f ? maxAABB.x : minAABB.x, normal.y >= 0.f ? maxAABB.y : minAABB.y, normal.z >= 0.f ? maxAABB.z : minAABB.z };
+				if (Vector3::Dot(normal, corner - origin) < -Margin)
+					return false;
+			}
+			return true;
+		}
+
+		static constexpr float Margin{ 0.001f };
 	};
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	//B3-spline, 1/16 1/4 3/8 1/4 1/16
+	constexpr float KernelWeights[5]{ 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+	//keeps dark albedos from blowing up the demodulated lighting
+	constexpr float MinAlbedo{ 0.01f };
+}
+
+void Denoiser::Resize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+
+	const size_t amountPixels{ size_t(width) * size_t(height) };
+
+	//shrinking keeps the capacity, so changing render scales don't reallocate
+	m_NormalX.resize(amountPixels);
+	m_NormalY.resize(amountPixels);
+	m_NormalZ.resize(amountPixels);
+	m_Depth.resize(amountPixels);
+	m_AlbedoR.resize(amountPixels);
+	m_AlbedoG.resize(amountPixels);
+	m_AlbedoB.resize(amountPixels);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		m_LightingR[i].resize(amountPixels);
+		m_LightingG[i].resize(amountPixels);
+		m_LightingB[i].resize(amountPixels);
+	}
+}
+
+void Denoiser::WriteGuide(uint32_t pixelIndex, const Vector3& normal, float depth, const ColorRGB& albedo)
+{
+	m_NormalX[pixelIndex] = normal.x;
+	m_NormalY[pixelIndex] = normal.y;
+	m_NormalZ[pixelIndex] = normal.z;
+	m_Depth[pixelIndex] = depth;
+	m_AlbedoR[pixelIndex] = albedo.r;
+	m_AlbedoG[pixelIndex] = albedo.g;
+	m_AlbedoB[pixelIndex] = albedo.b;
+}
+
+void Denoiser::WriteEmptyGuide(uint32_t pixelIndex)
+{
+	//a zero normal gives every tap a zero normal weight
+	WriteGuide(pixelIndex, {}, 0.f, {});
+}
+
+void Denoiser::Apply(std::vector<ColorRGB>& pixels)
+{
+	const size_t amountPixels{ size_t(m_Width) * size_t(m_Height) };
+
+	//Demodulate, the filter only blurs lighting, the albedo is multiplied back in at the end
+	m_Source = 0;
+	for (size_t i = 0; i < amountPixels; ++i)
+	{
+		m_LightingR[0][i] = pixels[i].r / std::max(m_AlbedoR[i], MinAlbedo);
+		m_LightingG[0][i] = pixels[i].g / std::max(m_AlbedoG[i], MinAlbedo);
+		m_LightingB[0][i] = pixels[i].b / std::max(m_AlbedoB[i], MinAlbedo);
+	}
+
+	//every pass doubles the step and tightens the color weight, so larger steps only smooth flat areas
+	float colorPhi{ ColorPhi };
+	for (int pass = 0; pass < Iterations; ++pass)
+	{
+		FilterPass(1 << pass, colorPhi);
+		colorPhi *= 0.5f;
+	}
+
+	//Remodulate
+	const std::vector<float>& lightingR{ m_LightingR[m_Source] };
+	const std::vector<float>& lightingG{ m_LightingG[m_Source] };
+	const std::vector<float>& lightingB{ m_LightingB[m_Source] };
+	for (size_t i = 0; i < amountPixels; ++i)
+	{
+		pixels[i].r = lightingR[i] * std::max(m_AlbedoR[i], MinAlbedo);
+		pixels[i].g = lightingG[i] * std::max(m_AlbedoG[i], MinAlbedo);
+		pixels[i].b = lightingB[i] * std::max(m_AlbedoB[i], MinAlbedo);
+	}
+}
+
+void Denoiser::FilterPass(int stepSize, float colorPhi)
+{
+	const int tilesX{ (m_Width + TileSize - 1) / TileSize };
+	const int tilesY{ (m_Height + TileSize - 1) / TileSize };
+
+	std::vector<int> tileIndices(tilesX * tilesY);
+	std::iota(tileIndices.begin(), tileIndices.end(), 0);
+
+	std::for_each(std::execution::par, tileIndices.begin(), tileIndices.end(), [&](int tileIndex) {
+		FilterTile(tileIndex % tilesX, tileIndex / tilesX, stepSize, colorPhi);
+		});
+
+	m_Source = 1 - m_Source;
+}
+
+void Denoiser::FilterTile(int tileX, int tileY, int stepSize, float colorPhi)
+{
+	const float* const srcR{ m_LightingR[m_Source].data() };
+	const float* const srcG{ m_LightingG[m_Source].data() };
+	const float* const srcB{ m_LightingB[m_Source].data() };
+	float* const dstR{ m_LightingR[1 - m_Source].data() };
+	float* const dstG{ m_LightingG[1 - m_Source].data() };
+	float* const dstB{ m_LightingB[1 - m_Source].data() };
+
+	const float* const normalX{ m_NormalX.data() };
+	const float* const normalY{ m_NormalY.data() };
+	const float* const normalZ{ m_NormalZ.data() };
+	const float* const depth{ m_Depth.data() };
+	const float* const albedoR{ m_AlbedoR.data() };
+	const float* const albedoG{ m_AlbedoG.data() };
+	const float* const albedoB{ m_AlbedoB.data() };
+
+	const float invColorPhi2{ 1.f / (colorPhi * colorPhi) };
+	const float invAlbedoPhi2{ 1.f / (AlbedoPhi * AlbedoPhi) };
+	const float depthPhi{ DepthPhi * stepSize };
+
+	const int startX{ tileX * TileSize };
+	const int endX{ std::min(startX + TileSize, m_Width) };
+	const int startY{ tileY * TileSize };
+	const int endY{ std::min(startY + TileSize, m_Height) };
+
+	float sumR[TileSize];
+	float sumG[TileSize];
+	float sumB[TileSize];
+	float sumWeight[TileSize];
+
+	for (int y = startY; y < endY; ++y)
+	{
+		const int row{ y * m_Width };
+
+		//the center tap always counts fully, so pixels without similar neighbours keep their own color
+		constexpr float centerWeight{ KernelWeights[2] * KernelWeights[2] };
+		for (int x = startX; x < endX; ++x)
+		{
+			sumR[x - startX] = srcR[row + x] * centerWeight;
+			sumG[x - startX] = srcG[row + x] * centerWeight;
+			sumB[x - startX] = srcB[row + x] * centerWeight;
+			sumWeight[x - startX] = centerWeight;
+		}
+
+		for (int ky = -2; ky <= 2; ++ky)
+		{
+			const int sampleY{ y + ky * stepSize };
+			if (sampleY < 0 || sampleY >= m_Height)
+				continue;
+
+			for (int kx = -2; kx <= 2; ++kx)
+			{
+				if (kx == 0 && ky == 0)
+					continue;
+
+				//taps outside the image are left out, the rest of the row reads contiguous memory
+				const int offset{ (sampleY - y) * m_Width + kx * stepSize };
+				const int spanStart{ std::max(startX, -kx * stepSize) };
+				const int spanEnd{ std::min(endX, m_Width - kx * stepSize) };
+				const float kernelWeight{ KernelWeights[kx + 2] * KernelWeights[ky + 2] };
+
+				for (int x = spanStart; x < spanEnd; ++x)
+				{
+					const int center{ row + x };
+					const int tap{ center + offset };
+
+					//normal weight, dot^128 by repeated squaring
+					float normalWeight{ std::max(0.f,
+						normalX[center] * normalX[tap] + normalY[center] * normalY[tap] + normalZ[center] * normalZ[tap]) };
+					for (int i = 0; i < 7; ++i)
+						normalWeight *= normalWeight;
+
+					const float depthDifference{ std::abs(depth[center] - depth[tap]) / (depthPhi * depth[center] + 1e-4f) };
+
+					const float dr{ srcR[center] - srcR[tap] };
+					const float dg{ srcG[center] - srcG[tap] };
+					const float db{ srcB[center] - srcB[tap] };
+					const float colorDifference{ (dr * dr + dg * dg + db * db) * invColorPhi2 };
+
+					const float ar{ albedoR[center] - albedoR[tap] };
+					const float ag{ albedoG[center] - albedoG[tap] };
+					const float ab{ albedoB[center] - albedoB[tap] };
+					const float albedoDifference{ (ar * ar + ag * ag + ab * ab) * invAlbedoPhi2 };
+
+					const float weight{ kernelWeight * normalWeight * std::exp(-(depthDifference + colorDifference + albedoDifference)) };
+
+					sumR[x - startX] += srcR[tap] * weight;
+					sumG[x - startX] += srcG[tap] * weight;
+					sumB[x - startX] += srcB[tap] * weight;
+					sumWeight[x - startX] += weight;
+				}
+			}
+		}
+
+		for (int x = startX; x < endX; ++x)
+		{
+			const float invWeight{ 1.f / sumWeight[x - startX] };
+			dstR[row + x] = sumR[x - startX] * invWeight;
+			dstG[row + x] = sumG[x - startX] * invWeight;
+			dstB[row + x] = sumB[x - startX] * invWeight;
+		}
+	}
+}
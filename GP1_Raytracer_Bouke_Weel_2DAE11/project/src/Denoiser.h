@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	//Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010).
+	//Every pass is a 5x5 B3-spline kernel with holes of 2^pass pixels, taps across normal, depth or albedo edges get no weight.
+	//Lighting is filtered with the albedo divided out so textures and material borders stay sharp.
+	//Buffers are stored per channel so the row loops auto-vectorize, tiles are filtered in parallel.
+	class Denoiser final
+	{
+	public:
+		Denoiser() = default;
+		~Denoiser() = default;
+
+		Denoiser(const Denoiser&) = delete;
+		Denoiser(Denoiser&&) noexcept = delete;
+		Denoiser& operator=(const Denoiser&) = delete;
+		Denoiser& operator=(Denoiser&&) noexcept = delete;
+
+		//has to be called before the guides of a frame are written
+		void Resize(int width, int height);
+
+		//safe to call from several threads as long as every thread writes other pixels
+		void WriteGuide(uint32_t pixelIndex, const Vector3& normal, float depth, const ColorRGB& albedo);
+		//pixels that hit nothing, they never blend with their neighbours
+		void WriteEmptyGuide(uint32_t pixelIndex);
+
+		//filters the first width*height pixels in place
+		void Apply(std::vector<ColorRGB>& pixels);
+
+	private:
+		void FilterPass(int stepSize, float colorPhi);
+		void FilterTile(int tileX, int tileY, int stepSize, float colorPhi);
+
+		static constexpr int TileSize{ 64 };
+		static constexpr int Iterations{ 4 };
+
+		//scale of the lighting difference between taps, shrinks every pass
+		static constexpr float ColorPhi{ 0.2f };
+		//relative depth difference per pixel of step size
+		static constexpr float DepthPhi{ 0.02f };
+		static constexpr float AlbedoPhi{ 0.1f };
+
+		int m_Width{};
+		int m_Height{};
+
+		//guides
+		std::vector<float> m_NormalX{};
+		std::vector<float> m_NormalY{};
+		std::vector<float> m_NormalZ{};
+		std::vector<float> m_Depth{};
+		std::vector<float> m_AlbedoR{};
+		std::vector<float> m_AlbedoG{};
+		std::vector<float> m_AlbedoB{};
+
+		//demodulated lighting, every pass reads one set and writes the other
+		std::vector<float> m_LightingR[2]{};
+		std::vector<float> m_LightingG[2]{};
+		std::vector<float> m_LightingB[2]{};
+		int m_Source{};
+	};
+}
@@ -0,0 +1,243 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+	void AppendUint32BigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t Crc32(const uint8_t* pData, size_t size)
+	{
+		static const std::array<uint32_t, 256> table = []
+		{
+			std::array<uint32_t, 256> result{};
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				result[n] = c;
+			}
+			return result;
+		}();
+
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	uint32_t Adler32(const std::vector<uint8_t>& data)
+	{
+		uint32_t a = 1, b = 0;
+		for (uint8_t byte : data)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void WritePNGChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk{};
+		chunk.reserve(data.size() + 12);
+
+		AppendUint32BigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		//crc covers type and data
+		AppendUint32BigEndian(chunk, Crc32(chunk.data() + 4, data.size() + 4));
+
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+}
+
+ImageWriter::ImageWriter(size_t maxQueuedImages) :
+	m_MaxQueuedImages(std::max<size_t>(1, maxQueuedImages))
+{
+	m_Thread = std::thread{ &ImageWriter::Run, this };
+}
+
+ImageWriter::~ImageWriter()
+{
+	//queued images are still written before the thread stops
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsRunning = false;
+	}
+	m_QueueChanged.notify_all();
+
+	m_Thread.join();
+}
+
+void ImageWriter::Save(std::vector<ColorRGB>&& pixels, int width, int height, const std::string& fileName, ImageFormat format)
+{
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_QueueChanged.wait(lock, [this] { return m_Jobs.size() < m_MaxQueuedImages; });
+
+		m_Jobs.push_back(Job{ std::move(pixels), width, height, fileName, format });
+	}
+	m_QueueChanged.notify_all();
+}
+
+void ImageWriter::Run()
+{
+	while (true)
+	{
+		Job job{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_QueueChanged.wait(lock, [this] { return !m_Jobs.empty() || !m_IsRunning; });
+
+			if (m_Jobs.empty())
+				return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+		m_QueueChanged.notify_all();
+
+		const bool succeeded{ job.format == ImageFormat::PNG ? WritePNG(job) : WriteHDR(job) };
+
+		if (succeeded)
+			std::cout << "Image saved: " << job.fileName << std::endl;
+		else
+			std::cout << "Something went wrong. Image not saved: " << job.fileName << std::endl;
+	}
+}
+
+bool ImageWriter::WritePNG(const Job& job)
+{
+	std::ofstream file(job.fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	//Scanlines: filter type 0 (none) followed by RGB8
+	std::vector<uint8_t> scanlines{};
+	scanlines.reserve(static_cast<size_t>(job.height) * (job.width * 3 + 1));
+	for (int y = 0; y < job.height; ++y)
+	{
+		scanlines.push_back(0);
+		for (int x = 0; x < job.width; ++x)
+		{
+			ColorRGB color{ job.pixels[x + y * job.width] };
+			color.MaxToOne();
+
+			scanlines.push_back(static_cast<uint8_t>(color.r * 255));
+			scanlines.push_back(static_cast<uint8_t>(color.g * 255));
+			scanlines.push_back(static_cast<uint8_t>(color.b * 255));
+		}
+	}
+
+	//zlib stream with stored deflate blocks, trades file size for not needing a compression library
+	constexpr size_t maxBlockSize{ 65535 };
+	std::vector<uint8_t> zlibData{ 0x78, 0x01 };
+	zlibData.reserve(scanlines.size() + scanlines.size() / maxBlockSize * 5 + 16);
+	for (size_t offset = 0; offset < scanlines.size(); offset += maxBlockSize)
+	{
+		const size_t blockSize{ std::min(maxBlockSize, scanlines.size() - offset) };
+		const bool isFinal{ offset + blockSize == scanlines.size() };
+
+		zlibData.push_back(isFinal ? 1 : 0);
+		zlibData.push_back(static_cast<uint8_t>(blockSize));
+		zlibData.push_back(static_cast<uint8_t>(blockSize >> 8));
+		zlibData.push_back(static_cast<uint8_t>(~blockSize));
+		zlibData.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		zlibData.insert(zlibData.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+	}
+	AppendUint32BigEndian(zlibData, Adler32(scanlines));
+
+	std::vector<uint8_t> header{};
+	AppendUint32BigEndian(header, static_cast<uint32_t>(job.width));
+	AppendUint32BigEndian(header, static_cast<uint32_t>(job.height));
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); //8 bit, RGB, deflate, adaptive filtering, no interlace
+
+	constexpr uint8_t signature[]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	WritePNGChunk(file, "IHDR", header);
+	WritePNGChunk(file, "IDAT", zlibData);
+	WritePNGChunk(file, "IEND", {});
+
+	return file.good();
+}
+
+bool ImageWriter::WriteHDR(const Job& job)
+{
+	std::ofstream file(job.fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	file << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n";
+	file << "-Y " << job.height << " +X " << job.width << "\n";
+
+	//Every scanline uses the run length layout with literal runs only,
+	//flat scanlines can be mistaken for run length ones by readers
+	std::vector<uint8_t> components(static_cast<size_t>(job.width) * 4);
+	std::vector<uint8_t> scanline{};
+	for (int y = 0; y < job.height; ++y)
+	{
+		for (int x = 0; x < job.width; ++x)
+		{
+			const ColorRGB& color{ job.pixels[x + y * job.width] };
+			const float maxComponent{ std::max(color.r, std::max(color.g, color.b)) };
+
+			uint8_t rgbe[4]{};
+			if (maxComponent > 1e-32f)
+			{
+				int exponent{};
+				const float scale{ std::frexp(maxComponent, &exponent) * 256.f / maxComponent };
+				rgbe[0] = static_cast<uint8_t>(std::max(0.f, color.r) * scale);
+				rgbe[1] = static_cast<uint8_t>(std::max(0.f, color.g) * scale);
+				rgbe[2] = static_cast<uint8_t>(std::max(0.f, color.b) * scale);
+				rgbe[3] = static_cast<uint8_t>(exponent + 128);
+			}
+
+			for (int c = 0; c < 4; ++c)
+				components[x + c * job.width] = rgbe[c];
+		}
+
+		scanline.clear();
+
+		//the run length layout only exists for these widths
+		if (job.width < 8 || job.width > 0x7FFF)
+		{
+			for (int x = 0; x < job.width; ++x)
+			{
+				for (int c = 0; c < 4; ++c)
+					scanline.push_back(components[x + c * job.width]);
+			}
+			file.write(reinterpret_cast<const char*>(scanline.data()), scanline.size());
+			continue;
+		}
+
+		scanline.insert(scanline.end(), { 2, 2, static_cast<uint8_t>(job.width >> 8), static_cast<uint8_t>(job.width) });
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int x = 0; x < job.width; x += 128)
+			{
+				const int runLength{ std::min(128, job.width - x) };
+				scanline.push_back(static_cast<uint8_t>(runLength));
+				scanline.insert(scanline.end(), components.begin() + x + c * job.width, components.begin() + x + c * job.width + runLength);
+			}
+		}
+
+		file.write(reinterpret_cast<const char*>(scanline.data()), scanline.size());
+	}
+
+	return file.good();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ColorRGB.h"
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		PNG,	//8 bit, clamped the same way as the window
+		HDR		//Radiance RGBE, keeps the unclamped radiance
+	};
+
+	//Encodes and writes images on a background thread so screenshots and frame dumps don't stall rendering.
+	//The queue is bounded: Save blocks while it is full, so a slow disk can't grow memory without limit.
+	class ImageWriter final
+	{
+	public:
+		ImageWriter(size_t maxQueuedImages = 8);
+		~ImageWriter();
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		//takes ownership of a copy of the frame
+		void Save(std::vector<ColorRGB>&& pixels, int width, int height, const std::string& fileName, ImageFormat format);
+
+	private:
+		struct Job
+		{
+			std::vector<ColorRGB> pixels{};
+			int width{};
+			int height{};
+			std::string fileName{};
+			ImageFormat format{};
+		};
+
+		void Run();
+
+		static bool WritePNG(const Job& job);
+		static bool WriteHDR(const Job& job);
+
+		size_t m_MaxQueuedImages{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_QueueChanged{};
+		std::deque<Job> m_Jobs{};
+		bool m_IsRunning{ true };
+
+		std::thread m_Thread{};
+	};
+}
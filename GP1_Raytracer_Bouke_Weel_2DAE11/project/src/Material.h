@@ -2,9 +2,19 @@
 #include "Maths.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
+#include "Sampling.h"
 
 namespace dae
 {
+	//Perfectly specular part of a material, the renderer follows it with secondary rays
+	struct SpecularBounce
+	{
+		ColorRGB reflectance{};		//weight of the reflected ray, black for none
+		ColorRGB transmittance{};	//weight of the refracted ray, black for none
+		Vector3 reflectDirection{};
+		Vector3 refractDirection{};
+	};
+
 #pragma region Material BASE
 	class Material
 	{
@@ -25,6 +35,39 @@ namespace dae
 		 * \return color
 		 */
 		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+
+		/**
+		 * \brief Base color of the surface, used as guide by the denoiser
+		 * \return albedo
+		 */
+		virtual ColorRGB GetAlbedo() const = 0;
+
+		/**
+		 * \brief Mirror reflection and refraction of the material, nothing for materials that only scatter light diffusely
+		 * \param hitRecord current hitrecord
+		 * \param v view direction (towards the viewer)
+		 * \return weights and directions of the secondary rays
+		 */
+		virtual SpecularBounce GetSpecularBounce(const HitRecord& /*hitRecord*/, const Vector3& /*v*/) const { return {}; }
+
+		/**
+		 * \brief Importance samples a light direction for path tracing, cosine weighted unless the material knows better
+		 * \param hitRecord current hitrecord
+		 * \param v view direction
+		 * \param u1 uniform random number [0, 1)
+		 * \param u2 uniform random number [0, 1)
+		 * \param u3 uniform random number [0, 1), picks the lobe for materials with more than one
+		 * \return light direction, GetPdf gives its probability density
+		 */
+		virtual Vector3 SampleDirection(const HitRecord& hitRecord, const Vector3& /*v*/, float u1, float u2, float /*u3*/) const
+		{
+			return Sampling::CosineHemisphere(hitRecord.normal, u1, u2);
+		}
+
+		virtual float GetPdf(const HitRecord& hitRecord, const Vector3& l, const Vector3& /*v*/) const
+		{
+			return Sampling::CosineHemispherePdf(hitRecord.normal, l);
+		}
 	};
 #pragma endregion
 
@@ -42,6 +85,8 @@ namespace dae
 			return m_Color;
 		}
 
+		ColorRGB GetAlbedo() const override { return m_Color; }
+
 	private:
 		ColorRGB m_Color{ colors::White };
 	};
@@ -61,6 +106,8 @@ namespace dae
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
+		ColorRGB GetAlbedo() const override { return m_DiffuseColor; }
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
@@ -84,6 +131,8 @@ namespace dae
 			+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
 		}
 
+		ColorRGB GetAlbedo() const override { return m_DiffuseColor; }
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 0.5f }; //kd
@@ -125,11 +174,130 @@ namespace dae
 				
 		}
 
+		ColorRGB GetAlbedo() const override { return m_Albedo; }
+
+		//One-sample MIS over the diffuse and GGX lobes, the pdf is the mixture of both
+		Vector3 SampleDirection(const HitRecord& hitRecord, const Vector3& v, float u1, float u2, float u3) const override
+		{
+			if (u3 < GetSpecularProbability())
+			{
+				const Vector3 h{ Sampling::GGXHalfVector(hitRecord.normal, m_Roughness, u1, u2) };
+				return Vector3::Reflect(-v, h);
+			}
+
+			return Sampling::CosineHemisphere(hitRecord.normal, u1, u2);
+		}
+
+		float GetPdf(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const override
+		{
+			const float specularProbability{ GetSpecularProbability() };
+
+			const Vector3 h{ (v + l).Normalized() };
+			const float viewDotHalf{ Vector3::Dot(v, h) };
+			const float specularPdf{ viewDotHalf > 0.f ?
+				BRDF::NormalDistribution_GGX(hitRecord.normal, h, m_Roughness) * std::max(0.f, Vector3::Dot(hitRecord.normal, h)) / (4.f * viewDotHalf) :
+				0.f };
+
+			return specularProbability * specularPdf + (1.f - specularProbability) * Sampling::CosineHemispherePdf(hitRecord.normal, l);
+		}
+
 	private:
 		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
 		float m_Metalness{ 1.0f };
 		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		//metals have no diffuse lobe
+		float GetSpecularProbability() const { return m_Metalness == 0.f ? 0.5f : 1.f; }
+	};
+#pragma endregion
+
+#pragma region Material MIRROR
+	//MIRROR
+	//======
+	class Material_Mirror final : public Material
+	{
+	public:
+		Material_Mirror(const ColorRGB& reflectance) : m_Reflectance(reflectance)
+		{}
+
+		//all light arrives through the reflection
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		{
+			return colors::Black;
+		}
+
+		ColorRGB GetAlbedo() const override { return m_Reflectance; }
+
+		SpecularBounce GetSpecularBounce(const HitRecord& hitRecord, const Vector3& v) const override
+		{
+			SpecularBounce bounce{};
+			bounce.reflectance = m_Reflectance;
+			bounce.reflectDirection = Vector3::Reflect(-v, hitRecord.normal);
+			return bounce;
+		}
+
+	private:
+		ColorRGB m_Reflectance{ colors::White };
+	};
+#pragma endregion
+
+#pragma region Material DIELECTRIC
+	//DIELECTRIC
+	//==========
+	class Material_Dielectric final : public Material
+	{
+	public:
+		Material_Dielectric(float indexOfRefraction, const ColorRGB& transmittance = colors::White) :
+			m_IndexOfRefraction(indexOfRefraction), m_Transmittance(transmittance)
+		{}
+
+		//all light arrives through the reflection and refraction
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		{
+			return colors::Black;
+		}
+
+		ColorRGB GetAlbedo() const override { return m_Transmittance; }
+
+		SpecularBounce GetSpecularBounce(const HitRecord& hitRecord, const Vector3& v) const override
+		{
+			//leaving the object when the view direction is on the back side of the normal
+			Vector3 normal{ hitRecord.normal };
+			float cosIncident{ Vector3::Dot(normal, v) };
+			float eta{ 1.f / m_IndexOfRefraction };
+			if (cosIncident < 0.f)
+			{
+				normal = -normal;
+				cosIncident = -cosIncident;
+				eta = m_IndexOfRefraction;
+			}
+
+			SpecularBounce bounce{};
+			bounce.reflectDirection = Vector3::Reflect(-v, normal);
+
+			//Snell, total internal reflection when there is no refracted direction
+			const float sinTransmittedSqr{ eta * eta * (1.f - cosIncident * cosIncident) };
+			if (sinTransmittedSqr >= 1.f)
+			{
+				bounce.reflectance = colors::White;
+				return bounce;
+			}
+
+			const float cosTransmitted{ sqrtf(1.f - sinTransmittedSqr) };
+			bounce.refractDirection = (-v * eta + normal * (eta * cosIncident - cosTransmitted)).Normalized();
+
+			//Schlick approximation of the Fresnel reflectance
+			const float f0{ Square((1.f - m_IndexOfRefraction) / (1.f + m_IndexOfRefraction)) };
+			const float fresnel{ f0 + (1.f - f0) * powf(1.f - (eta > 1.f ? cosTransmitted : cosIncident), 5.f) };
+
+			bounce.reflectance = ColorRGB{ 1.f, 1.f, 1.f } * fresnel;
+			bounce.transmittance = m_Transmittance * (1.f - fresnel);
+			return bounce;
+		}
+
+	private:
+		float m_IndexOfRefraction{ 1.5f };
+		ColorRGB m_Transmittance{ colors::White };
 	};
 #pragma endregion
 }
- 
\ No newline at end of file
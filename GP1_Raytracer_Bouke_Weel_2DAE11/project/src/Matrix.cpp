@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include "Matrix.h"
+#include "MathHelpers.h"
 
 namespace dae {
 	Matrix::Matrix(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis, const Vector3& t) :
@@ -73,6 +74,43 @@ namespace dae {
 		return *this;
 	}
 
+	const Matrix& Matrix::Inverse()
+	{
+		//Optimized Inverse as explained in FGED1 - used widely in other libraries too.
+		const Vector3& a = data[0];
+		const Vector3& b = data[1];
+		const Vector3& c = data[2];
+		const Vector3& d = data[3];
+
+		const float x = data[0][3];
+		const float y = data[1][3];
+		const float z = data[2][3];
+		const float w = data[3][3];
+
+		Vector3 s = Vector3::Cross(a, b);
+		Vector3 t = Vector3::Cross(c, d);
+		Vector3 u = a * y - b * x;
+		Vector3 v = c * w - d * z;
+
+		float det = Vector3::Dot(s, v) + Vector3::Dot(t, u);
+		assert((!AreEqual(det, 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+		float invDet = 1.f / det;
+
+		s *= invDet; t *= invDet; u *= invDet; v *= invDet;
+
+		Vector3 r0 = Vector3::Cross(b, v) + t * y;
+		Vector3 r1 = Vector3::Cross(v, a) - t * x;
+		Vector3 r2 = Vector3::Cross(d, u) + s * w;
+		Vector3 r3 = Vector3::Cross(u, c) - s * z;
+
+		data[0] = Vector4{ r0.x, r1.x, r2.x, r3.x };
+		data[1] = Vector4{ r0.y, r1.y, r2.y, r3.y };
+		data[2] = Vector4{ r0.z, r1.z, r2.z, r3.z };
+		data[3] = { { -Vector3::Dot(b, t)},{Vector3::Dot(a, t)},{-Vector3::Dot(d, s)},{Vector3::Dot(c, s)} };
+
+		return *this;
+	}
+
 	Matrix Matrix::Transpose(const Matrix& m)
 	{
 		Matrix out{ m };
@@ -81,6 +119,14 @@ namespace dae {
 		return out;
 	}
 
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
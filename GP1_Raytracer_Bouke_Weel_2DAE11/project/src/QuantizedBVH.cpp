@@ -0,0 +1,310 @@
+#include "QuantizedBVH.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	struct Bounds
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			min = Vector3::Min(min, point);
+			max = Vector3::Max(max, point);
+		}
+
+		void Grow(const Bounds& other)
+		{
+			min = Vector3::Min(min, other.min);
+			max = Vector3::Max(max, other.max);
+		}
+
+		float GetHalfArea() const
+		{
+			if (min.x > max.x)
+				return 0.f;
+
+			const Vector3 size{ max - min };
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+	};
+
+	//Binary tree the wide nodes are collapsed from, only lives during Build
+	struct BuildNode
+	{
+		Bounds bounds{};
+		int left{ -1 };
+		int right{ -1 };
+		int first{};
+		int count{};
+
+		bool IsLeaf() const { return left < 0; }
+	};
+
+	constexpr int BinCount{ 12 };
+	//median splits halve the triangles, 24 levels are enough for the leaves of any mesh below MaxTriangles
+	constexpr int MedianSplitDepth{ QuantizedBVH::MaxDepth - 24 };
+
+	class BinaryBuilder final
+	{
+	public:
+		BinaryBuilder(const std::vector<Bounds>& triangleBounds, const std::vector<Vector3>& centroids) :
+			m_TriangleBounds{ triangleBounds },
+			m_Centroids{ centroids },
+			m_Order(triangleBounds.size())
+		{
+			std::iota(m_Order.begin(), m_Order.end(), 0);
+			m_Nodes.reserve(triangleBounds.size() * 2);
+		}
+
+		int Build(int first, int count, int depth)
+		{
+			const int nodeIndex{ static_cast<int>(m_Nodes.size()) };
+			m_Nodes.emplace_back();
+
+			Bounds bounds{}, centroidBounds{};
+			for (int i = first; i < first + count; ++i)
+			{
+				bounds.Grow(m_TriangleBounds[m_Order[i]]);
+				centroidBounds.Grow(m_Centroids[m_Order[i]]);
+			}
+			m_Nodes[nodeIndex].bounds = bounds;
+			m_Nodes[nodeIndex].first = first;
+			m_Nodes[nodeIndex].count = count;
+
+			if (count <= QuantizedBVH::MaxLeafSize)
+				return nodeIndex;
+
+			//SAH can keep splitting off a few triangles at a time on clustered centroids
+			const int middle{ depth < MedianSplitDepth ? Split(first, count, centroidBounds) : SplitMedian(first, count, centroidBounds) };
+			const int left{ Build(first, middle - first, depth + 1) };
+			const int right{ Build(middle, first + count - middle, depth + 1) };
+			m_Nodes[nodeIndex].left = left;
+			m_Nodes[nodeIndex].right = right;
+			return nodeIndex;
+		}
+
+		const std::vector<BuildNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<int>& GetOrder() const { return m_Order; }
+
+	private:
+		const std::vector<Bounds>& m_TriangleBounds;
+		const std::vector<Vector3>& m_Centroids;
+		std::vector<int> m_Order;
+		std::vector<BuildNode> m_Nodes{};
+
+		static int GetLargestAxis(const Vector3& extent)
+		{
+			int axis{ 0 };
+			if (extent.y > extent[axis]) axis = 1;
+			if (extent.z > extent[axis]) axis = 2;
+			return axis;
+		}
+
+		//Half of the triangles on each side, along the axis the centroids spread the most
+		int SplitMedian(int first, int count, const Bounds& centroidBounds)
+		{
+			const int axis{ GetLargestAxis(centroidBounds.max - centroidBounds.min) };
+			const auto begin{ m_Order.begin() + first };
+			std::nth_element(begin, begin + count / 2, begin + count,
+				[&](int left, int right) { return m_Centroids[left][axis] < m_Centroids[right][axis]; });
+			return first + count / 2;
+		}
+
+		//Binned surface area heuristic, returns where the right half starts
+		int Split(int first, int count, const Bounds& centroidBounds)
+		{
+			const Vector3 extent{ centroidBounds.max - centroidBounds.min };
+			const int axis{ GetLargestAxis(extent) };
+
+			const auto begin{ m_Order.begin() + first };
+			const auto end{ begin + count };
+
+			//every centroid in the same spot, any split is as good as another
+			if (extent[axis] <= 0.f)
+				return first + count / 2;
+
+			const float binScale{ BinCount / extent[axis] };
+			const auto getBin{ [&](int triangle)
+				{
+					const int bin{ static_cast<int>((m_Centroids[triangle][axis] - centroidBounds.min[axis]) * binScale) };
+					return std::min(bin, BinCount - 1);
+				} };
+
+			Bounds binBounds[BinCount]{};
+			int binCounts[BinCount]{};
+			for (auto it = begin; it != end; ++it)
+			{
+				const int bin{ getBin(*it) };
+				binBounds[bin].Grow(m_TriangleBounds[*it]);
+				++binCounts[bin];
+			}
+
+			//sweep from the right to get the cost of every right half, then from the left to find the cheapest plane
+			float rightCosts[BinCount]{};
+			Bounds rightBounds{};
+			int rightCount{ 0 };
+			for (int bin = BinCount - 1; bin > 0; --bin)
+			{
+				rightBounds.Grow(binBounds[bin]);
+				rightCount += binCounts[bin];
+				rightCosts[bin] = rightBounds.GetHalfArea() * rightCount;
+			}
+
+			int bestPlane{ -1 };
+			float bestCost{ FLT_MAX };
+			Bounds leftBounds{};
+			int leftCount{ 0 };
+			for (int plane = 1; plane < BinCount; ++plane)
+			{
+				leftBounds.Grow(binBounds[plane - 1]);
+				leftCount += binCounts[plane - 1];
+				if (leftCount == 0 || leftCount == count)
+					continue;
+
+				const float cost{ leftBounds.GetHalfArea() * leftCount + rightCosts[plane] };
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestPlane = plane;
+				}
+			}
+
+			if (bestPlane < 0)
+				return first + count / 2;
+
+			const auto middle{ std::partition(begin, end, [&](int triangle) { return getBin(triangle) < bestPlane; }) };
+			return static_cast<int>(middle - m_Order.begin());
+		}
+	};
+}
+
+void QuantizedBVH::Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<Vector3>& normals)
+{
+	m_Nodes.clear();
+
+	const int triangleCount{ static_cast<int>(indices.size() / 3) };
+	if (triangleCount == 0)
+		return;
+
+	assert(triangleCount < MaxTriangles && "Leaves only address 24 bits of triangles");
+
+	std::vector<Bounds> triangleBounds(triangleCount);
+	std::vector<Vector3> centroids(triangleCount);
+	for (int triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			triangleBounds[triangle].Grow(positions[indices[triangle * 3 + corner]]);
+		}
+		centroids[triangle] = (triangleBounds[triangle].min + triangleBounds[triangle].max) * 0.5f;
+	}
+
+	BinaryBuilder builder{ triangleBounds, centroids };
+	builder.Build(0, triangleCount, 0);
+	const std::vector<BuildNode>& buildNodes{ builder.GetNodes() };
+
+	//every wide node replaces at least one binary inner node
+	m_Nodes.reserve(buildNodes.size() / 2 + 1);
+
+	const auto collapse{ [&](const auto& self, int buildIndex, int depth) -> uint32_t
+		{
+			//every wide level takes at least one binary level, which the builder keeps below MaxDepth
+			assert(depth < MaxDepth && "Traversal stack is too small for this tree");
+
+			//open the largest inner children until there are four, a leaf root becomes the only child
+			int children[4]{ buildIndex };
+			int childCount{ 1 };
+			while (childCount < 4)
+			{
+				int largest{ -1 };
+				for (int i = 0; i < childCount; ++i)
+				{
+					const BuildNode& child{ buildNodes[children[i]] };
+					if (!child.IsLeaf() && (largest < 0 || child.bounds.GetHalfArea() > buildNodes[children[largest]].bounds.GetHalfArea()))
+						largest = i;
+				}
+				if (largest < 0)
+					break;
+
+				const BuildNode& opened{ buildNodes[children[largest]] };
+				children[largest] = opened.left;
+				children[childCount++] = opened.right;
+			}
+
+			const uint32_t nodeIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+			m_Nodes.emplace_back();
+
+			//padded so flat meshes still get a volume and rays on the border aren't lost to rounding
+			const Bounds& bounds{ buildNodes[buildIndex].bounds };
+			const Vector3 extent{ bounds.max - bounds.min };
+			const float padding{ std::max({ extent.x, extent.y, extent.z, 1e-4f }) * 1e-4f };
+
+			Node node{};
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				node.origin[axis] = bounds.min[axis] - padding;
+				node.step[axis] = (extent[axis] + 2.f * padding) / 255.f;
+			}
+
+			for (int child = 0; child < 4; ++child)
+			{
+				if (child >= childCount)
+				{
+					node.children[child] = EmptyChild;
+					continue;
+				}
+
+				const BuildNode& buildChild{ buildNodes[children[child]] };
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					int low{ static_cast<int>(std::floor((buildChild.bounds.min[axis] - node.origin[axis]) / node.step[axis])) };
+					int high{ static_cast<int>(std::ceil((buildChild.bounds.max[axis] - node.origin[axis]) / node.step[axis])) };
+					low = std::clamp(low, 0, 255);
+					high = std::clamp(high, 0, 255);
+
+					//the decoded box has to contain the child, float rounding may not shrink it
+					while (low > 0 && node.origin[axis] + low * node.step[axis] > buildChild.bounds.min[axis])
+						--low;
+					while (high < 255 && node.origin[axis] + high * node.step[axis] < buildChild.bounds.max[axis])
+						++high;
+
+					node.childMin[axis][child] = static_cast<uint8_t>(low);
+					node.childMax[axis][child] = static_cast<uint8_t>(high);
+				}
+
+				if (buildChild.IsLeaf())
+					node.children[child] = LeafBit | static_cast<uint32_t>(buildChild.count) << 24 | static_cast<uint32_t>(buildChild.first);
+				else
+					node.children[child] = self(self, children[child], depth + 1);
+			}
+
+			m_Nodes[nodeIndex] = node;
+			return nodeIndex;
+		} };
+
+	collapse(collapse, 0, 0);
+
+	//leaves point into the triangle arrays, store the triangles in the order of the tree
+	const std::vector<int>& order{ builder.GetOrder() };
+	std::vector<int> sortedIndices(indices.size());
+	std::vector<Vector3> sortedNormals(normals.size());
+	for (int triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			sortedIndices[triangle * 3 + corner] = indices[order[triangle] * 3 + corner];
+		}
+		if (!normals.empty())
+			sortedNormals[triangle] = normals[order[triangle]];
+	}
+	indices = std::move(sortedIndices);
+	normals = std::move(sortedNormals);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Compressed 4-wide BVH over the triangles of a mesh, in object space so it survives any transform.
+	//A node stores its own bounds once and every child box as 8 bit steps inside them, 64 bytes (one cache line)
+	//for four children. Leaves are ranges of the mesh triangles, which Build reorders, so no index list is needed.
+	class QuantizedBVH final
+	{
+	public:
+		QuantizedBVH() = default;
+		~QuantizedBVH() = default;
+
+		QuantizedBVH(const QuantizedBVH&) = default;
+		QuantizedBVH(QuantizedBVH&&) noexcept = default;
+		QuantizedBVH& operator=(const QuantizedBVH&) = default;
+		QuantizedBVH& operator=(QuantizedBVH&&) noexcept = default;
+
+		//Reorders the triangles (indices and per triangle normals) so every leaf is a contiguous range
+		void Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<Vector3>& normals);
+
+		/**
+		 * \brief Visits the leaves the ray passes through, nearest child first
+		 * \param origin Ray origin in object space
+		 * \param direction Ray direction in object space, doesn't need to be normalized
+		 * \param tMin Start of the ray
+		 * \param tMax End of the ray, leafTest shortens it when it finds a closer hit
+		 * \param leafTest bool(int firstTriangle, int triangleCount, float& tMax), returns true to stop traversal
+		 */
+		template<typename LeafTest>
+		void Traverse(const Vector3& origin, const Vector3& direction, float tMin, float tMax, LeafTest&& leafTest) const;
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		size_t GetNodeCount() const { return m_Nodes.size(); }
+		size_t GetMemorySize() const { return m_Nodes.capacity() * sizeof(Node); }
+
+		//leaves hold at most this many triangles
+		static constexpr int MaxLeafSize{ 4 };
+		//triangle indices of leaves have 24 bits
+		static constexpr int MaxTriangles{ 1 << 24 };
+		//levels of the tree, Build stays below it so the fixed traversal stack can't overflow
+		static constexpr int MaxDepth{ 64 };
+
+	private:
+		struct Node
+		{
+			Vector3 origin{};				//minimum of the node bounds
+			Vector3 step{};					//size of one quantization step per axis
+			uint8_t childMin[3][4]{};		//per axis, per child, rounded down
+			uint8_t childMax[3][4]{};		//rounded up
+			uint32_t children[4]{};			//inner node index, or LeafBit | count << 24 | first triangle
+		};
+
+		static constexpr uint32_t LeafBit{ 1u << 31 };
+		//unused slot of a node with less than four children
+		static constexpr uint32_t EmptyChild{ LeafBit };
+		//worst case traversal stack: three children pushed per level
+		static constexpr int MaxStackSize{ 3 * MaxDepth + 1 };
+
+		std::vector<Node> m_Nodes{};
+	};
+
+	template<typename LeafTest>
+	void QuantizedBVH::Traverse(const Vector3& origin, const Vector3& direction, float tMin, float tMax, LeafTest&& leafTest) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		const Vector3 inverseDirection{ 1.f / direction.x, 1.f / direction.y, 1.f / direction.z };
+		//child boxes are read from the min or the max side depending on the ray direction
+		const bool isNegative[3]{ inverseDirection.x < 0.f, inverseDirection.y < 0.f, inverseDirection.z < 0.f };
+
+		struct StackEntry
+		{
+			uint32_t child{};
+			float tEntry{};
+		};
+		StackEntry stack[MaxStackSize];
+		int stackSize{ 0 };
+		stack[stackSize++] = { 0, tMin };
+
+		while (stackSize > 0)
+		{
+			const StackEntry entry{ stack[--stackSize] };
+			//a closer hit was found after this was pushed
+			if (entry.tEntry > tMax)
+				continue;
+
+			if (entry.child & LeafBit)
+			{
+				const int count{ static_cast<int>((entry.child >> 24) & 0x7F) };
+				if (leafTest(static_cast<int>(entry.child & 0xFFFFFF), count, tMax))
+					return;
+				continue;
+			}
+
+			const Node& node{ m_Nodes[entry.child] };
+
+			//t of a quantized plane is a + q * b
+			float a[3]{}, b[3]{};
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				a[axis] = (node.origin[axis] - origin[axis]) * inverseDirection[axis];
+				b[axis] = node.step[axis] * inverseDirection[axis];
+			}
+
+			StackEntry hits[4]{};
+			int hitCount{ 0 };
+			for (int child = 0; child < 4; ++child)
+			{
+				if (node.children[child] == EmptyChild)
+					continue;
+
+				float tNear{ tMin }, tFar{ tMax };
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const uint8_t nearStep{ isNegative[axis] ? node.childMax[axis][child] : node.childMin[axis][child] };
+					const uint8_t farStep{ isNegative[axis] ? node.childMin[axis][child] : node.childMax[axis][child] };
+					tNear = std::max(tNear, a[axis] + nearStep * b[axis]);
+					tFar = std::min(tFar, a[axis] + farStep * b[axis]);
+				}
+
+				if (tNear <= tFar)
+					hits[hitCount++] = { node.children[child], tNear };
+			}
+
+			//farthest child is pushed first so the nearest one is traversed first, insertion sort as there are at most four
+			for (int i = 1; i < hitCount; ++i)
+			{
+				const StackEntry hit{ hits[i] };
+				int j{ i };
+				for (; j > 0 && hits[j - 1].tEntry < hit.tEntry; --j)
+				{
+					hits[j] = hits[j - 1];
+				}
+				hits[j] = hit;
+			}
+			for (int i = 0; i < hitCount; ++i)
+			{
+				stack[stackSize++] = hits[i];
+			}
+		}
+	}
+}
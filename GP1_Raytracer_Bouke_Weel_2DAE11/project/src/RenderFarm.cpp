@@ -0,0 +1,547 @@
+#include "RenderFarm.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "ImageWriter.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Socket.h"
+#include "TileScheduler.h"
+#include "Timer.h"
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+using namespace dae;
+
+namespace
+{
+	//Messages are sequences of big endian 32 bit words, floats are sent as their bits
+	//handshake: process id of the worker, sent once after connecting
+	//job:       tile, frame width, frame height, samples per pixel, x, y, width, height, time
+	//result:    tile, pixel count, pixel count * (r, g, b)
+	constexpr size_t HandshakeWords{ 1 };
+	constexpr size_t JobWords{ 9 };
+	constexpr size_t ResultHeaderWords{ 2 };
+	constexpr uint32_t QuitTile{ UINT32_MAX };
+
+	//select timeout of the coordinator loop, bounds how late hung workers are noticed
+	constexpr int PollIntervalMs{ 100 };
+	//the coordinator gives up when it has no workers for this long
+	constexpr double NoWorkerTimeout{ 30.0 };
+	//workers get this long to finish their last tile after the farm is done, the rest is killed
+	constexpr int ShutdownTimeoutMs{ 5000 };
+
+	struct TileJob
+	{
+		uint32_t tile{};
+		int frameWidth{};
+		int frameHeight{};
+		int samplesPerPixel{};
+		FarmTile area{};
+		float time{};
+	};
+
+	void WriteWord(uint8_t* pBytes, uint32_t word)
+	{
+		pBytes[0] = static_cast<uint8_t>(word >> 24);
+		pBytes[1] = static_cast<uint8_t>(word >> 16);
+		pBytes[2] = static_cast<uint8_t>(word >> 8);
+		pBytes[3] = static_cast<uint8_t>(word);
+	}
+
+	uint32_t ReadWord(const uint8_t* pBytes)
+	{
+		return uint32_t(pBytes[0]) << 24 | uint32_t(pBytes[1]) << 16 | uint32_t(pBytes[2]) << 8 | uint32_t(pBytes[3]);
+	}
+
+	bool SendJob(const Socket& socket, const TileJob& job)
+	{
+		const uint32_t words[JobWords]{ job.tile, uint32_t(job.frameWidth), uint32_t(job.frameHeight), uint32_t(job.samplesPerPixel),
+			uint32_t(job.area.x), uint32_t(job.area.y), uint32_t(job.area.width), uint32_t(job.area.height), std::bit_cast<uint32_t>(job.time) };
+
+		uint8_t bytes[JobWords * 4]{};
+		for (size_t i = 0; i < JobWords; ++i)
+		{
+			WriteWord(bytes + i * 4, words[i]);
+		}
+		return socket.SendAll(bytes, sizeof(bytes));
+	}
+
+	bool ReceiveJob(const Socket& socket, TileJob& job)
+	{
+		uint8_t bytes[JobWords * 4]{};
+		if (!socket.ReceiveAll(bytes, sizeof(bytes)))
+			return false;
+
+		uint32_t words[JobWords]{};
+		for (size_t i = 0; i < JobWords; ++i)
+		{
+			words[i] = ReadWord(bytes + i * 4);
+		}
+
+		job.tile = words[0];
+		job.frameWidth = int(words[1]);
+		job.frameHeight = int(words[2]);
+		job.samplesPerPixel = int(words[3]);
+		job.area = { 0, int(words[4]), int(words[5]), int(words[6]), int(words[7]) };
+		job.time = std::bit_cast<float>(words[8]);
+		return true;
+	}
+
+	bool SendTile(const Socket& socket, uint32_t tile, const std::vector<ColorRGB>& pixels, std::vector<uint8_t>& buffer)
+	{
+		buffer.resize((ResultHeaderWords + pixels.size() * 3) * 4);
+		uint8_t* pBytes{ buffer.data() };
+		WriteWord(pBytes, tile);
+		WriteWord(pBytes + 4, uint32_t(pixels.size()));
+		pBytes += ResultHeaderWords * 4;
+
+		for (const ColorRGB& pixel : pixels)
+		{
+			WriteWord(pBytes, std::bit_cast<uint32_t>(pixel.r));
+			WriteWord(pBytes + 4, std::bit_cast<uint32_t>(pixel.g));
+			WriteWord(pBytes + 8, std::bit_cast<uint32_t>(pixel.b));
+			pBytes += 12;
+		}
+		return socket.SendAll(buffer.data(), buffer.size());
+	}
+
+	uint32_t GetOwnProcessId()
+	{
+#ifdef _WIN32
+		return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	//Worker processes, started with the same executable
+	struct WorkerProcess
+	{
+#ifdef _WIN32
+		HANDLE handle{};
+#else
+		pid_t pid{};
+#endif
+		//connections are accepted in any order, the handshake tells which process is behind one
+		uint32_t id{};
+	};
+
+	bool LaunchWorker(const std::string& executable, uint16_t port, WorkerProcess& process)
+	{
+		const std::string portArgument{ std::to_string(port) };
+#ifdef _WIN32
+		std::string commandLine{ "\"" + executable + "\" --worker " + portArgument };
+		STARTUPINFOA startupInfo{};
+		startupInfo.cb = sizeof(startupInfo);
+		PROCESS_INFORMATION processInfo{};
+		if (!CreateProcessA(executable.c_str(), commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+			return false;
+
+		CloseHandle(processInfo.hThread);
+		process.handle = processInfo.hProcess;
+		process.id = static_cast<uint32_t>(processInfo.dwProcessId);
+		return true;
+#else
+		const std::string workerArgument{ "--worker" };
+		char* arguments[]{ const_cast<char*>(executable.c_str()), const_cast<char*>(workerArgument.c_str()), const_cast<char*>(portArgument.c_str()), nullptr };
+		if (posix_spawn(&process.pid, executable.c_str(), nullptr, nullptr, arguments, environ) != 0)
+			return false;
+
+		process.id = static_cast<uint32_t>(process.pid);
+		return true;
+#endif
+	}
+
+	//a hung worker never reads the quit message, so dropped workers are killed
+	void KillWorker(const WorkerProcess& process)
+	{
+#ifdef _WIN32
+		TerminateProcess(process.handle, 1);
+#else
+		kill(process.pid, SIGKILL);
+#endif
+	}
+
+	//true when the process exited within the timeout
+	bool WaitForWorker(const WorkerProcess& process, int timeoutMs)
+	{
+#ifdef _WIN32
+		return WaitForSingleObject(process.handle, static_cast<DWORD>(timeoutMs)) == WAIT_OBJECT_0;
+#else
+		const auto endTime{ std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs) };
+		while (true)
+		{
+			//an error means there is no child left to wait for either
+			if (waitpid(process.pid, nullptr, WNOHANG) != 0)
+				return true;
+
+			if (std::chrono::steady_clock::now() >= endTime)
+				return false;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+#endif
+	}
+
+	double GetSeconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+RenderFarm::RenderFarm(const RenderFarmSettings& settings) :
+	m_Settings(settings)
+{
+}
+
+bool RenderFarm::Run()
+{
+	Timer timer{};
+	timer.Start();
+
+	const BatchSettings& batch{ m_Settings.batch };
+
+	Socket listener{ Socket::Listen(m_Settings.port) };
+	if (!listener.IsValid())
+	{
+		std::cout << "Render farm can't listen on port " << m_Settings.port << std::endl;
+		return false;
+	}
+	const uint16_t port{ listener.GetPort() };
+
+	//frames are cut in rows of tiles, in frame order so only a few frames are assembled at once
+	std::vector<FarmTile> tiles{};
+	for (int frame = 0; frame < batch.frameCount; ++frame)
+	{
+		for (int y = 0; y < batch.height; y += m_Settings.tileSize)
+		{
+			for (int x = 0; x < batch.width; x += m_Settings.tileSize)
+			{
+				tiles.push_back({ frame, x, y, std::min(m_Settings.tileSize, batch.width - x), std::min(m_Settings.tileSize, batch.height - y) });
+			}
+		}
+	}
+	const int tilesPerFrame{ batch.frameCount > 0 ? static_cast<int>(tiles.size()) / batch.frameCount : 0 };
+	TileScheduler scheduler{ tiles };
+
+	std::cout << "Render farm on 127.0.0.1:" << port << ", " << batch.frameCount << " frames in " << tiles.size() << " tiles" << std::endl;
+
+	std::vector<WorkerProcess> processes{};
+	if (!m_Settings.workerExecutable.empty())
+	{
+		for (int i = 0; i < m_Settings.workerCount; ++i)
+		{
+			WorkerProcess process{};
+			if (LaunchWorker(m_Settings.workerExecutable, port, process))
+				processes.push_back(process);
+			else
+				std::cout << "Failed to start worker " << m_Settings.workerExecutable << std::endl;
+		}
+	}
+
+	struct FrameBuffer
+	{
+		std::vector<ColorRGB> pixels{};
+		int remainingTiles{};
+	};
+
+	struct WorkerConnection
+	{
+		Socket socket{};
+		//index in processes, -1 for workers started by hand
+		int process{ -1 };
+		//tiles are only sent after the handshake
+		bool isReady{ false };
+		//the message coming in, read as it arrives so one slow worker can't stall the others
+		std::vector<uint8_t> message{};
+	};
+
+	//indexed by worker, closed sockets are lost workers
+	std::vector<WorkerConnection> workers{};
+	std::map<int, FrameBuffer> frames{};
+	bool isAborted{ false };
+
+	{
+		ImageWriter imageWriter{};
+
+		const auto dropWorker = [&](int worker, const char* reason)
+			{
+				std::cout << "Worker " << worker << ' ' << reason << ", its tile goes back to the farm" << std::endl;
+				WorkerConnection& connection{ workers[worker] };
+				connection.socket.Close();
+				scheduler.Fail(worker);
+
+				if (connection.process >= 0)
+				{
+					KillWorker(processes[connection.process]);
+					connection.process = -1;
+				}
+			};
+
+		const auto receiveHandshake = [&](WorkerConnection& connection)
+			{
+				const uint32_t processId{ ReadWord(connection.message.data()) };
+				for (int process = 0; process < static_cast<int>(processes.size()); ++process)
+				{
+					if (processes[process].id == processId)
+						connection.process = process;
+				}
+				connection.isReady = true;
+			};
+
+		//the pixels are only read once the header is known to belong to the assigned tile
+		const auto checkResultHeader = [&](int worker) -> bool
+			{
+				const std::vector<uint8_t>& message{ workers[worker].message };
+				const int tile{ scheduler.GetAssignedTile(worker) };
+				if (tile < 0 || ReadWord(message.data()) != uint32_t(tile))
+					return false;
+
+				const FarmTile& area{ scheduler.GetTile(tile) };
+				return ReadWord(message.data() + 4) == uint32_t(area.width * area.height);
+			};
+
+		const auto receiveTile = [&](int worker)
+			{
+				const std::vector<uint8_t>& message{ workers[worker].message };
+				const FarmTile& area{ scheduler.GetTile(scheduler.GetAssignedTile(worker)) };
+
+				//a copy of this tile already came back
+				if (!scheduler.Complete(worker, GetSeconds()))
+					return;
+
+				FrameBuffer& frame{ frames[area.frame] };
+				if (frame.pixels.empty())
+				{
+					frame.pixels.resize(batch.width * batch.height);
+					frame.remainingTiles = tilesPerFrame;
+				}
+
+				const uint8_t* pBytes{ message.data() + ResultHeaderWords * 4 };
+				for (int y = 0; y < area.height; ++y)
+				{
+					for (int x = 0; x < area.width; ++x)
+					{
+						ColorRGB& pixel{ frame.pixels[(area.x + x) + (area.y + y) * batch.width] };
+						pixel.r = std::bit_cast<float>(ReadWord(pBytes));
+						pixel.g = std::bit_cast<float>(ReadWord(pBytes + 4));
+						pixel.b = std::bit_cast<float>(ReadWord(pBytes + 8));
+						pBytes += 12;
+					}
+				}
+
+				if (--frame.remainingTiles == 0)
+				{
+					imageWriter.Save(std::move(frame.pixels), batch.width, batch.height, batch.GetFileName(area.frame), ImageFormat::PNG);
+					frames.erase(area.frame);
+					std::cout << "Frame " << area.frame << " done" << std::endl;
+				}
+			};
+
+		//false when the worker is lost
+		const auto receive = [&](int worker) -> bool
+			{
+				WorkerConnection& connection{ workers[worker] };
+				std::vector<uint8_t>& message{ connection.message };
+
+				//a handshake first, then results, the pixel count of a result is known once its header is in
+				size_t messageSize{ connection.isReady ? ResultHeaderWords * 4 : HandshakeWords * 4 };
+				if (connection.isReady && message.size() >= messageSize)
+					messageSize += size_t(ReadWord(message.data() + 4)) * 12;
+
+				const size_t receivedSize{ message.size() };
+				message.resize(messageSize);
+				const int received{ connection.socket.Receive(message.data() + receivedSize, messageSize - receivedSize) };
+				if (received <= 0)
+					return false;
+
+				message.resize(receivedSize + received);
+				if (message.size() < messageSize)
+					return true;
+
+				if (!connection.isReady)
+					receiveHandshake(connection);
+				else if (messageSize == ResultHeaderWords * 4)
+					return checkResultHeader(worker);
+				else
+					receiveTile(worker);
+
+				message.clear();
+				return true;
+			};
+
+		double lastWorkerTime{ GetSeconds() };
+		while (!scheduler.IsFinished())
+		{
+			const double time{ GetSeconds() };
+
+			//every idle worker gets a tile
+			for (int worker = 0; worker < static_cast<int>(workers.size()); ++worker)
+			{
+				if (!workers[worker].isReady || !workers[worker].socket.IsValid() || scheduler.GetAssignedTile(worker) >= 0)
+					continue;
+
+				const int tile{ scheduler.Assign(worker, time) };
+				if (tile < 0)
+					continue;
+
+				const TileJob job{ uint32_t(tile), batch.width, batch.height, batch.samplesPerPixel, scheduler.GetTile(tile),
+					batch.startTime + scheduler.GetTile(tile).frame / batch.framesPerSecond };
+				if (!SendJob(workers[worker].socket, job))
+					dropWorker(worker, "disconnected");
+			}
+
+			//new workers and finished tiles
+			std::vector<const Socket*> waitSockets{ &listener };
+			for (const WorkerConnection& worker : workers)
+			{
+				waitSockets.push_back(&worker.socket);
+			}
+			const std::vector<bool> isReadable{ Socket::WaitReadable(waitSockets, PollIntervalMs) };
+
+			for (int worker = 0; worker < static_cast<int>(workers.size()); ++worker)
+			{
+				if (isReadable[worker + 1] && !receive(worker))
+					dropWorker(worker, "disconnected");
+			}
+
+			if (isReadable[0])
+			{
+				Socket connection{ listener.Accept(0) };
+				if (connection.IsValid())
+				{
+					workers.push_back({ std::move(connection) });
+					std::cout << "Worker " << workers.size() - 1 << " connected" << std::endl;
+				}
+			}
+
+			for (int worker : scheduler.GetHungWorkers(GetSeconds()))
+			{
+				dropWorker(worker, "stopped responding");
+			}
+
+			if (std::any_of(workers.begin(), workers.end(), [](const WorkerConnection& worker) { return worker.socket.IsValid(); }))
+			{
+				lastWorkerTime = GetSeconds();
+			}
+			else if (GetSeconds() - lastWorkerTime > NoWorkerTimeout)
+			{
+				std::cout << "Render farm has no workers left" << std::endl;
+				isAborted = true;
+				break;
+			}
+		}
+
+		//workers that are still around stop after their current tile
+		for (const WorkerConnection& worker : workers)
+		{
+			if (worker.socket.IsValid())
+				SendJob(worker.socket, { QuitTile });
+		}
+	}
+
+	workers.clear();
+
+	//one deadline for all of them, whatever is still running after it is hung or lost its connection
+	const auto shutdownEnd{ std::chrono::steady_clock::now() + std::chrono::milliseconds(ShutdownTimeoutMs) };
+	for (const WorkerProcess& process : processes)
+	{
+		const auto remainingTime{ std::max(std::chrono::steady_clock::duration::zero(), shutdownEnd - std::chrono::steady_clock::now()) };
+		if (!WaitForWorker(process, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(remainingTime).count())))
+		{
+			KillWorker(process);
+			WaitForWorker(process, ShutdownTimeoutMs);
+		}
+#ifdef _WIN32
+		CloseHandle(process.handle);
+#endif
+	}
+
+	timer.Update();
+	std::cout << "Render farm finished in " << timer.GetTotal() << " seconds" << std::endl;
+	return !isAborted;
+}
+
+void RenderFarm::RunWorker(const std::function<Scene*()>& createScene, const std::string& host, uint16_t port)
+{
+	//the coordinator can still be starting up
+	constexpr int MaxConnectAttempts{ 50 };
+	Socket connection{};
+	for (int attempt = 0; attempt < MaxConnectAttempts && !connection.IsValid(); ++attempt)
+	{
+		connection = Socket::Connect(host, port);
+		if (!connection.IsValid())
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	if (!connection.IsValid())
+	{
+		std::cout << "Worker can't reach the render farm on " << host << ':' << port << std::endl;
+		return;
+	}
+
+	uint8_t handshake[HandshakeWords * 4]{};
+	WriteWord(handshake, GetOwnProcessId());
+	if (!connection.SendAll(handshake, sizeof(handshake)))
+		return;
+
+	Scene* pScene{ createScene() };
+	pScene->Initialize();
+
+	Renderer* pRenderer{};
+	TileJob rendererJob{};
+	std::vector<ColorRGB> pixels{};
+	std::vector<uint8_t> sendBuffer{};
+
+	TileJob job{};
+	while (ReceiveJob(connection, job) && job.tile != QuitTile)
+	{
+		//the renderer only has to be rebuilt when the frame settings change
+		if (!pRenderer || job.frameWidth != rendererJob.frameWidth || job.frameHeight != rendererJob.frameHeight
+			|| job.samplesPerPixel != rendererJob.samplesPerPixel)
+		{
+			delete pRenderer;
+			pRenderer = new Renderer(job.frameWidth, job.frameHeight);
+			if (job.samplesPerPixel > 0)
+				pRenderer->TogglePathTracing();
+			rendererJob = job;
+		}
+
+		pScene->Animate(job.time);
+		pRenderer->SetRenderRegion(job.area.x, job.area.y, job.area.width, job.area.height);
+
+		//same as BatchRenderer, every render after the first one adds a sample
+		for (int sample = 0; sample < std::max(1, job.samplesPerPixel); ++sample)
+		{
+			pRenderer->Render(pScene);
+		}
+
+		pixels.resize(job.area.width * job.area.height);
+		pRenderer->CopyRegion(job.area.x, job.area.y, job.area.width, job.area.height, pixels.data());
+		if (!SendTile(connection, job.tile, pixels, sendBuffer))
+			break;
+	}
+
+	delete pRenderer;
+	delete pScene;
+}
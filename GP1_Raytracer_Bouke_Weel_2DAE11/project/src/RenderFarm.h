@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "BatchRenderer.h"
+
+namespace dae
+{
+	class Scene;
+
+	struct RenderFarmSettings
+	{
+		BatchSettings batch{};
+
+		int workerCount{ 4 };
+		int tileSize{ 64 };
+		//0 lets the system pick a free port
+		uint16_t port{ 0 };
+
+		//started once per worker with --worker <port>, leave empty to start the workers by hand
+		std::string workerExecutable{};
+	};
+
+	//Offline rendering split over worker processes: frames are cut into tiles, workers connect over TCP loopback,
+	//trace the tiles they are sent with an offscreen Renderer and send the radiance back. The coordinator assembles
+	//the frames and gives tiles of dead or slow workers to others (see TileScheduler).
+	class RenderFarm final
+	{
+	public:
+		RenderFarm(const RenderFarmSettings& settings);
+		~RenderFarm() = default;
+
+		RenderFarm(const RenderFarm&) = delete;
+		RenderFarm(RenderFarm&&) noexcept = delete;
+		RenderFarm& operator=(const RenderFarm&) = delete;
+		RenderFarm& operator=(RenderFarm&&) noexcept = delete;
+
+		//blocks until every frame is written, false when all workers were lost
+		bool Run();
+
+		//Worker process, traces tiles for the coordinator at host:port until it is told to stop
+		static void RunWorker(const std::function<Scene*()>& createScene, const std::string& host, uint16_t port);
+
+	private:
+		RenderFarmSettings m_Settings{};
+	};
+}
@@ -0,0 +1,182 @@
+#include "RenderThread.h"
+
+#include <iostream>
+
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+using namespace dae;
+
+RenderThread::RenderThread(Renderer* pRenderer, Scene* pScene) :
+	m_pRenderer(pRenderer),
+	m_pScene(pScene),
+	m_Camera(pScene->GetCamera())
+{
+	//start last, everything the thread reads is initialized by now
+	m_Thread = std::thread{ &RenderThread::Run, this };
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsRunning = false;
+	}
+	m_StateChanged.notify_one();
+
+	m_Thread.join();
+}
+
+void RenderThread::Submit(const Camera& camera, float totalTime)
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_Camera = camera;
+		//keep the dirty flag of snapshots the render thread never picked up
+		m_CameraDirty = m_CameraDirty || camera.isDirty;
+		m_TotalTime = totalTime;
+		m_HasNewState = true;
+	}
+	m_StateChanged.notify_one();
+}
+
+void RenderThread::QueueToggleShadows()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingShadowToggles;
+}
+
+void RenderThread::QueueCycleLightingMode()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingLightingModeCycles;
+}
+
+void RenderThread::QueueToggleDynamicResolution()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingDynamicResolutionToggles;
+}
+
+void RenderThread::QueueToggleDenoiser()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingDenoiserToggles;
+}
+
+void RenderThread::QueueToggleReprojection()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingReprojectionToggles;
+}
+
+void RenderThread::QueueToggleAdaptiveSampling()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingAdaptiveSamplingToggles;
+}
+
+void RenderThread::QueueTogglePathTracing()
+{
+	std::lock_guard lock{ m_Mutex };
+	++m_PendingPathTracingToggles;
+}
+
+void RenderThread::Run()
+{
+	Timer frameTimer{};
+	frameTimer.Start();
+	float printTimer = 0.f;
+	bool renderedLastIteration = false;
+
+	while (true)
+	{
+		Camera camera{};
+		bool cameraDirty{};
+		float totalTime{};
+		int shadowToggles{};
+		int lightingModeCycles{};
+		int dynamicResolutionToggles{};
+		int denoiserToggles{};
+		int reprojectionToggles{};
+		int adaptiveSamplingToggles{};
+		int pathTracingToggles{};
+
+		//--------- Take newest state ---------
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_StateChanged.wait(lock, [this] { return m_HasNewState || !m_IsRunning; });
+
+			if (!m_IsRunning)
+				return;
+
+			camera = m_Camera;
+			cameraDirty = m_CameraDirty;
+			totalTime = m_TotalTime;
+			shadowToggles = m_PendingShadowToggles;
+			lightingModeCycles = m_PendingLightingModeCycles;
+			dynamicResolutionToggles = m_PendingDynamicResolutionToggles;
+			denoiserToggles = m_PendingDenoiserToggles;
+			reprojectionToggles = m_PendingReprojectionToggles;
+			adaptiveSamplingToggles = m_PendingAdaptiveSamplingToggles;
+			pathTracingToggles = m_PendingPathTracingToggles;
+
+			m_CameraDirty = false;
+			m_PendingShadowToggles = 0;
+			m_PendingLightingModeCycles = 0;
+			m_PendingDynamicResolutionToggles = 0;
+			m_PendingDenoiserToggles = 0;
+			m_PendingReprojectionToggles = 0;
+			m_PendingAdaptiveSamplingToggles = 0;
+			m_PendingPathTracingToggles = 0;
+			m_HasNewState = false;
+		}
+
+		//--------- Update ---------
+		Camera& sceneCamera = m_pScene->GetCamera();
+		camera.isDirty = cameraDirty || sceneCamera.isDirty;
+		sceneCamera = camera;
+
+		m_pScene->Animate(totalTime);
+
+		for (int i = 0; i < shadowToggles; ++i)
+			m_pRenderer->ToggleShadows();
+		for (int i = 0; i < lightingModeCycles; ++i)
+			m_pRenderer->CycleLightingMode();
+		for (int i = 0; i < dynamicResolutionToggles; ++i)
+			m_pRenderer->ToggleDynamicResolution();
+		for (int i = 0; i < denoiserToggles; ++i)
+			m_pRenderer->ToggleDenoiser();
+		for (int i = 0; i < reprojectionToggles; ++i)
+			m_pRenderer->ToggleReprojection();
+		for (int i = 0; i < adaptiveSamplingToggles; ++i)
+			m_pRenderer->ToggleAdaptiveSampling();
+		for (int i = 0; i < pathTracingToggles; ++i)
+			m_pRenderer->TogglePathTracing();
+
+		//--------- Render ---------
+		if (!m_pRenderer->NeedsRender(m_pScene))
+		{
+			renderedLastIteration = false;
+			continue;
+		}
+
+		m_pRenderer->Render(m_pScene);
+
+		//--------- Timer ---------
+		frameTimer.Update();
+
+		//only back to back frames measure a real frame time, the first one after idling includes the wait
+		if (renderedLastIteration)
+			m_pRenderer->ReportFrameTime(frameTimer.GetElapsed());
+		renderedLastIteration = true;
+		printTimer += frameTimer.GetElapsed();
+		if (printTimer >= 1.f)
+		{
+			printTimer = 0.f;
+			std::cout << "dFPS: " << frameTimer.GetdFPS() << std::endl;
+			m_pRenderer->PrintRayCounts();
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Camera.h"
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+
+	//Runs the renderer on its own thread so input, update and present keep a fixed rate.
+	//The input thread submits camera snapshots, every frame starts from the newest one.
+	class RenderThread final
+	{
+	public:
+		RenderThread(Renderer* pRenderer, Scene* pScene);
+		~RenderThread();
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread(RenderThread&&) noexcept = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+		RenderThread& operator=(RenderThread&&) noexcept = delete;
+
+		void Submit(const Camera& camera, float totalTime);
+
+		//renderer toggles are applied by the render thread between frames
+		void QueueToggleShadows();
+		void QueueCycleLightingMode();
+		void QueueToggleDynamicResolution();
+		void QueueToggleDenoiser();
+		void QueueToggleReprojection();
+		void QueueToggleAdaptiveSampling();
+		void QueueTogglePathTracing();
+
+	private:
+		void Run();
+
+		Renderer* m_pRenderer{};
+		Scene* m_pScene{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+
+		Camera m_Camera{};
+		bool m_CameraDirty{ false };
+		float m_TotalTime{ 0.f };
+		int m_PendingShadowToggles{ 0 };
+		int m_PendingLightingModeCycles{ 0 };
+		int m_PendingDynamicResolutionToggles{ 0 };
+		int m_PendingDenoiserToggles{ 0 };
+		int m_PendingReprojectionToggles{ 0 };
+		int m_PendingAdaptiveSamplingToggles{ 0 };
+		int m_PendingPathTracingToggles{ 0 };
+		bool m_HasNewState{ false };
+		bool m_IsRunning{ true };
+
+		std::thread m_Thread{};
+	};
+}
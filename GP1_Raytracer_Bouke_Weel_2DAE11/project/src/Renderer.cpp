@@ -5,11 +5,14 @@
 //Project includes
 #include "Renderer.h"
 
+#include <algorithm>
 #include <execution>
 #include <iostream>
+#include <numeric>
 #include "Maths.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "Sampling.h"
 #include "Scene.h"
 #include "Utils.h"
 
@@ -24,79 +27,628 @@ Renderer::Renderer(SDL_Window * pWindow) :
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_BackBufferPixels.resize(m_Width * m_Height);
+	m_HdrPixels.resize(m_Width * m_Height);
+	m_FrontHdrPixels.resize(m_Width * m_Height);
+	m_ScaledPixels.resize(m_Width * m_Height);
+	m_AccumulatedPixels.resize(m_Width * m_Height);
+	m_Cache.resize(m_Width * m_Height);
+	m_ReprojectedCache.resize(m_Width * m_Height);
+	m_ShadowStates.resize(m_Width * m_Height);
 }
 
-void Renderer::Render(Scene* pScene) const
+Renderer::Renderer(int width, int height) :
+	m_IsOffscreen(true),
+	m_RegionWidth(width),
+	m_RegionHeight(height),
+	m_pBuffer(SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0)),
+	m_Width(width),
+	m_Height(height)
+{
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_BackBufferPixels.resize(m_Width * m_Height);
+	m_HdrPixels.resize(m_Width * m_Height);
+	m_FrontHdrPixels.resize(m_Width * m_Height);
+	m_ScaledPixels.resize(m_Width * m_Height);
+	m_AccumulatedPixels.resize(m_Width * m_Height);
+	m_Cache.resize(m_Width * m_Height);
+	m_ReprojectedCache.resize(m_Width * m_Height);
+	m_ShadowStates.resize(m_Width * m_Height);
+}
+
+Renderer::~Renderer()
+{
+	//the window surface belongs to the window
+	if (m_IsOffscreen)
+		SDL_FreeSurface(m_pBuffer);
+}
+
+void Renderer::Render(Scene* pScene)
 {
 	Camera& camera = pScene->GetCamera();
 
+	//Dynamic resolution holds the target frame time while anything changes,
+	//otherwise progressive resolution: coarse while the camera moves, refine towards full resolution once it stops
+	//A camera move with unchanged geometry and settings reuses last frame's shading at full resolution instead
+	m_IsReprojectedFrame = m_ReprojectionEnabled && !m_PathTracingEnabled && m_HasValidCache && camera.isDirty && !m_IsDirty && !pScene->IsGeometryDirty();
+	m_IsDynamicResolutionFrame = !m_IsReprojectedFrame && m_DynamicResolutionEnabled && (m_IsDirty || pScene->IsDirty());
+	if (m_IsOffscreen || m_IsReprojectedFrame)
+		m_RenderScale = 1.f;
+	else if (m_IsDynamicResolutionFrame)
+		m_RenderScale = m_ResolutionController.GetScale();
+	else if (camera.isDirty)
+		m_RenderScale = m_MotionRenderScale;
+	else
+		m_RenderScale = std::min(1.f, m_RenderScale * 2.f);
+
+	m_RenderWidth = std::max(1, static_cast<int>(m_Width * m_RenderScale));
+	m_RenderHeight = std::max(1, static_cast<int>(m_Height * m_RenderScale));
+
 	const float aspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 	const float FOV = tan(camera.fovAngle / 2);
 	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
 
-	const uint32_t amountPixels{ uint32_t(m_Width * m_Height) };
+	const bool isScaledFrame{ m_RenderWidth != m_Width || m_RenderHeight != m_Height };
+	//adaptive sampling would interpolate the noise of the path tracer
+	const bool isAdaptiveFrame{ m_AdaptiveSamplingEnabled && !m_PathTracingEnabled && !m_IsReprojectedFrame };
+
+	//path traced frames are averaged until anything changes
+	if (m_IsDirty || pScene->IsDirty() || isScaledFrame)
+		m_AccumulatedSamples = 0;
+
+	if (m_DenoiserEnabled)
+		m_Denoiser.Resize(m_RenderWidth, m_RenderHeight);
 
+	if (isAdaptiveFrame)
+	{
+		RenderAdaptive(pScene, FOV, aspectRatio, cameraToWorld, camera.origin);
+	}
+	else if (m_IsReprojectedFrame)
+	{
+		const std::vector<uint32_t> pixelIndices{ ReprojectCache(FOV, aspectRatio, cameraToWorld, camera.origin) };
 #if defined(PARALLEL_EXECUTION)
+		std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](uint32_t i) {
+			RenderPixel(pScene, i, FOV, aspectRatio, cameraToWorld, camera.origin);
+			});
+#else
+		for (uint32_t i : pixelIndices)
+		{
+			RenderPixel(pScene, i, FOV, aspectRatio, cameraToWorld, camera.origin);
+		}
+#endif
+	}
+	else if (m_IsOffscreen)
+	{
+		RenderTiles(pScene, m_RegionX, m_RegionY, m_RegionX + m_RegionWidth, m_RegionY + m_RegionHeight, FOV, aspectRatio, cameraToWorld, camera.origin);
+	}
+	else
+	{
+		RenderTiles(pScene, 0, 0, m_RenderWidth, m_RenderHeight, FOV, aspectRatio, cameraToWorld, camera.origin);
+	}
+
+	if (m_DenoiserEnabled)
+	{
+		m_Denoiser.Apply(isScaledFrame ? m_ScaledPixels : m_HdrPixels);
+		if (!isScaledFrame)
+			HdrToBackBuffer();
+	}
+
+	if (isScaledFrame)
+		UpscaleToBackBuffer();
 
-	std::vector<uint32_t> pixelIndices{};
+	//reprojected frames only traced part of the pixels, their shadow states are incomplete
+	if (!m_IsReprojectedFrame)
+		UpdatePenumbraMask(pScene);
 
-	pixelIndices.reserve(amountPixels);
-	for (uint32_t index = 0; index < amountPixels; ++index)
+	//@END
+	//Hand the finished frame to the SDL Surface, Present shows it
 	{
-		pixelIndices.emplace_back(index);
+		std::lock_guard lock{ m_PresentMutex };
+		std::copy(m_BackBufferPixels.begin(), m_BackBufferPixels.end(), m_pBufferPixels);
+		//every pixel is rewritten each frame, so the buffers can just trade places
+		m_HdrPixels.swap(m_FrontHdrPixels);
+		m_HasNewFrame = true;
 	}
 
-	std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](int i) {
-		RenderPixel(pScene, i, FOV, aspectRatio, cameraToWorld, camera.origin);
+	for (int depth = 0; depth <= MaxBounceDepth; ++depth)
+	{
+		m_LastFrameRayCounts[depth] = m_RayCounts[depth].exchange(0);
+	}
+
+	if (m_PathTracingEnabled && !isScaledFrame)
+		++m_AccumulatedSamples;
+
+	//only full resolution frames fill the whole cache
+	m_HasValidCache = m_ReprojectionEnabled && !isScaledFrame;
+	++m_FrameCounter;
+
+	//a change starts a new round of soft shadow refinement
+	if (m_IsDirty || pScene->IsDirty())
+		m_ShadowRefinements = 0;
+	else if (m_NeedsShadowRefinement)
+		++m_ShadowRefinements;
+
+	//frame is up to date with the scene
+	pScene->ClearDirty();
+	m_IsDirty = false;
+}
+
+bool Renderer::Present()
+{
+	std::lock_guard lock{ m_PresentMutex };
+	if (!m_HasNewFrame)
+		return false;
+
+	SDL_UpdateWindowSurface(m_pWindow);
+	m_HasNewFrame = false;
+	return true;
+}
+
+bool Renderer::NeedsRender(const Scene* pScene) const
+{
+	//a coarse or reprojected frame still has to be refined even when nothing changed, path tracing keeps converging
+	return m_IsDirty || m_RenderScale < 1.f || m_IsReprojectedFrame || pScene->IsDirty()
+		|| (m_PathTracingEnabled && m_AccumulatedSamples < MaxAccumulatedSamples)
+		|| (m_NeedsShadowRefinement && m_ShadowRefinements < MaxShadowRefinements);
+}
+
+void Renderer::PrintRayCounts() const
+{
+	std::cout << "Rays per bounce depth:";
+	for (int depth = 0; depth <= MaxBounceDepth && m_LastFrameRayCounts[depth] > 0; ++depth)
+	{
+		std::cout << ' ' << depth << ": " << m_LastFrameRayCounts[depth];
+	}
+	std::cout << std::endl;
+}
+
+void Renderer::ToggleDynamicResolution()
+{
+	m_DynamicResolutionEnabled = !m_DynamicResolutionEnabled;
+	m_ResolutionController.Reset();
+	m_IsDirty = true;
+
+	if (m_DynamicResolutionEnabled)
+		std::cout << "Dynamic resolution on, target " << m_ResolutionController.GetTargetFrameTime() * 1000.f << " ms\n";
+	else
+		std::cout << "Dynamic resolution off\n";
+}
+
+void Renderer::ToggleDenoiser()
+{
+	m_DenoiserEnabled = !m_DenoiserEnabled;
+	m_IsDirty = true;
+
+	std::cout << (m_DenoiserEnabled ? "Denoiser on\n" : "Denoiser off\n");
+}
+
+void Renderer::TogglePathTracing()
+{
+	m_PathTracingEnabled = !m_PathTracingEnabled;
+	m_AccumulatedSamples = 0;
+	m_IsDirty = true;
+
+	std::cout << (m_PathTracingEnabled ? "Path tracing on\n" : "Path tracing off\n");
+}
+
+void Renderer::ToggleReprojection()
+{
+	m_ReprojectionEnabled = !m_ReprojectionEnabled;
+	m_HasValidCache = false;
+	m_IsDirty = true;
+
+	std::cout << (m_ReprojectionEnabled ? "Temporal reprojection on\n" : "Temporal reprojection off\n");
+}
+
+void Renderer::ReportFrameTime(float frameTime)
+{
+	//refinement frames of a static view don't say anything about the cost of changing frames
+	if (m_IsDynamicResolutionFrame)
+		m_ResolutionController.Update(frameTime);
+}
+
+int Renderer::GetShadowBudget(int px, int py) const
+{
+	if (m_PenumbraWidth == 0)
+		return 1;
+
+	//the mask can come from a frame with another render resolution
+	const int maskX{ std::min(m_PenumbraWidth - 1, px * m_PenumbraWidth / m_RenderWidth) };
+	const int maskY{ std::min(m_PenumbraHeight - 1, py * m_PenumbraHeight / m_RenderHeight) };
+	return m_PenumbraMask[maskX + maskY * m_PenumbraWidth] ? MaxShadowSamples : 1;
+}
+
+void Renderer::UpdatePenumbraMask(const Scene* pScene)
+{
+	m_NeedsShadowRefinement = false;
+
+	const auto& lights{ pScene->GetLights() };
+	const bool hasAreaLights{ std::any_of(lights.begin(), lights.end(), [](const Light& light) { return LightUtils::IsAreaLight(light); }) };
+	if (!hasAreaLights || !m_ShadowsEnabled || m_PathTracingEnabled)
+	{
+		m_PenumbraWidth = 0;
+		m_PenumbraHeight = 0;
+		return;
+	}
+
+	m_PenumbraWidth = m_RenderWidth;
+	m_PenumbraHeight = m_RenderHeight;
+	m_PenumbraMask.resize(m_PenumbraWidth * m_PenumbraHeight);
+
+	std::vector<uint32_t> rows(m_PenumbraHeight);
+	std::iota(rows.begin(), rows.end(), 0);
+
+	//a penumbra sees part of a light, or sits next to a pixel that sees the lights differently (the edge of a hard
+	//shadow traced with one ray). Dilating it also catches the soft edge where one ray hit the fully lit side
+	std::atomic<bool> needsRefinement{ false };
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](uint32_t y) {
+		for (int x = 0; x < m_PenumbraWidth; ++x)
+		{
+			const uint32_t state{ m_ShadowStates[x + y * m_PenumbraWidth] & ~FullShadowBudgetBit };
+			bool isPenumbra{ (state & (state >> 1) & 0x55555555u) != 0 };
+
+			for (int offsetY = -PenumbraRadius; offsetY <= PenumbraRadius && !isPenumbra; ++offsetY)
+			{
+				const int neighbourY{ static_cast<int>(y) + offsetY };
+				if (neighbourY < 0 || neighbourY >= m_PenumbraHeight)
+					continue;
+
+				for (int offsetX = -PenumbraRadius; offsetX <= PenumbraRadius && !isPenumbra; ++offsetX)
+				{
+					const int neighbourX{ x + offsetX };
+					if (neighbourX < 0 || neighbourX >= m_PenumbraWidth)
+						continue;
+
+					//background pixels have no shadows to compare
+					const uint32_t neighbourState{ m_ShadowStates[neighbourX + neighbourY * m_PenumbraWidth] & ~FullShadowBudgetBit };
+					isPenumbra = state != 0 && neighbourState != 0 && neighbourState != state;
+				}
+			}
+
+			const uint32_t maskIndex{ x + y * m_PenumbraWidth };
+			m_PenumbraMask[maskIndex] = isPenumbra;
+			//traced with a single shadow ray, the next frame has to redo it with the full budget
+			if (isPenumbra && !(m_ShadowStates[maskIndex] & FullShadowBudgetBit))
+				needsRefinement = true;
+		}
 		});
 
-#else
-	for (uint32_t i = 0; i < amountPixels; ++i)
+	m_NeedsShadowRefinement = needsRefinement;
+}
+
+void Renderer::UpscaleToBackBuffer()
+{
+	//Bilinear upscale of the reduced resolution frame to the full back buffer
+	const float scaleX{ static_cast<float>(m_RenderWidth) / static_cast<float>(m_Width) };
+	const float scaleY{ static_cast<float>(m_RenderHeight) / static_cast<float>(m_Height) };
+
+	std::vector<uint32_t> rowIndices(m_Height);
+	std::iota(rowIndices.begin(), rowIndices.end(), 0);
+
+	std::for_each(std::execution::par, rowIndices.begin(), rowIndices.end(), [&](uint32_t py) {
+		const float sy{ std::clamp((py + 0.5f) * scaleY - 0.5f, 0.f, static_cast<float>(m_RenderHeight - 1)) };
+		const int y0{ static_cast<int>(sy) };
+		const int y1{ std::min(y0 + 1, m_RenderHeight - 1) };
+		const float fy{ sy - y0 };
+
+		for (int px = 0; px < m_Width; ++px)
+		{
+			const float sx{ std::clamp((px + 0.5f) * scaleX - 0.5f, 0.f, static_cast<float>(m_RenderWidth - 1)) };
+			const int x0{ static_cast<int>(sx) };
+			const int x1{ std::min(x0 + 1, m_RenderWidth - 1) };
+			const float fx{ sx - x0 };
+
+			const ColorRGB top{ ColorRGB::Lerp(m_ScaledPixels[x0 + y0 * m_RenderWidth], m_ScaledPixels[x1 + y0 * m_RenderWidth], fx) };
+			const ColorRGB bottom{ ColorRGB::Lerp(m_ScaledPixels[x0 + y1 * m_RenderWidth], m_ScaledPixels[x1 + y1 * m_RenderWidth], fx) };
+			ColorRGB finalColor{ ColorRGB::Lerp(top, bottom, fy) };
+
+			m_HdrPixels[px + (py * m_Width)] = finalColor;
+			WriteBackBufferPixel(px + (py * m_Width), finalColor);
+		}
+		});
+}
+
+void Renderer::HdrToBackBuffer()
+{
+	std::vector<uint32_t> rowIndices(m_Height);
+	std::iota(rowIndices.begin(), rowIndices.end(), 0);
+
+	std::for_each(std::execution::par, rowIndices.begin(), rowIndices.end(), [&](uint32_t py) {
+		for (int px = 0; px < m_Width; ++px)
+		{
+			WriteBackBufferPixel(px + (py * m_Width), m_HdrPixels[px + (py * m_Width)]);
+		}
+		});
+}
+
+void Renderer::WriteBackBufferPixel(uint32_t pixelIndex, ColorRGB color)
+{
+	color.MaxToOne();
+
+	m_BackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+		static_cast<uint8_t>(color.r * 255),
+		static_cast<uint8_t>(color.g * 255),
+		static_cast<uint8_t>(color.b * 255));
+}
+
+std::vector<uint32_t> Renderer::ReprojectCache(float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	//Serial, the scatter needs a depth test per target pixel and only costs a few ms
+	constexpr float MaxViewAngleCosine{ 0.995f };	//specular shading changes with the view direction
+	constexpr float DepthTolerance{ 1.05f };		//relative to the closest neighbour
+	constexpr uint32_t RefreshInterval{ 16 };		//every pixel is traced again at least once per 16 reprojected frames
+
+	const Vector3 right{ cameraToWorld.GetAxisX() };
+	const Vector3 up{ cameraToWorld.GetAxisY() };
+	const Vector3 forward{ cameraToWorld.GetAxisZ() };
+
+	std::fill(m_ReprojectedCache.begin(), m_ReprojectedCache.end(), CachedPixel{});
+
+	//Scatter the surface points of last frame into the new view, closest point wins
+	for (const CachedPixel& cachedPixel : m_Cache)
+	{
+		if (!cachedPixel.isValid || !cachedPixel.didHit)
+			continue;
+
+		const Vector3 toPoint{ cachedPixel.position - cameraOrigin };
+		const float viewZ{ Vector3::Dot(toPoint, forward) };
+		if (viewZ <= 0.f)
+			continue;
+
+		const float cx{ Vector3::Dot(toPoint, right) / viewZ };
+		const float cy{ Vector3::Dot(toPoint, up) / viewZ };
+		const int px{ static_cast<int>(std::floor((cx / (aspectRatio * fov) + 1.f) * 0.5f * m_Width)) };
+		const int py{ static_cast<int>(std::floor((1.f - cy / fov) * 0.5f * m_Height)) };
+		if (px < 0 || px >= m_Width || py < 0 || py >= m_Height)
+			continue;
+
+		const float depth{ toPoint.Magnitude() };
+		const Vector3 viewDirection{ toPoint / depth };
+
+		//backfacing points and points seen from a too different angle are traced again
+		if (Vector3::Dot(cachedPixel.normal, viewDirection) >= 0.f ||
+			Vector3::Dot(cachedPixel.viewDirection, viewDirection) < MaxViewAngleCosine)
+			continue;
+
+		CachedPixel& target{ m_ReprojectedCache[px + (py * m_Width)] };
+		if (depth < target.depth)
+		{
+			target = cachedPixel;
+			target.depth = depth;
+		}
+	}
+
+	//Disocclusion check, a point much further away than a neighbour most likely leaked through a gap of a closer surface
+	std::vector<uint32_t> tracePixels{};
+	for (int py = 0; py < m_Height; ++py)
+	{
+		for (int px = 0; px < m_Width; ++px)
+		{
+			const uint32_t pixelIndex{ uint32_t(px + (py * m_Width)) };
+			CachedPixel& cachedPixel{ m_ReprojectedCache[pixelIndex] };
+
+			float closestNeighbour{ FLT_MAX };
+			for (int y = std::max(0, py - 1); y <= std::min(m_Height - 1, py + 1); ++y)
+			{
+				for (int x = std::max(0, px - 1); x <= std::min(m_Width - 1, px + 1); ++x)
+				{
+					closestNeighbour = std::min(closestNeighbour, m_ReprojectedCache[x + (y * m_Width)].depth);
+				}
+			}
+
+			const bool isRefreshed{ ((px & 3) | ((py & 3) << 2)) == m_FrameCounter % RefreshInterval };
+			if (!cachedPixel.isValid || isRefreshed || cachedPixel.depth > closestNeighbour * DepthTolerance)
+			{
+				tracePixels.emplace_back(pixelIndex);
+				continue;
+			}
+
+			m_HdrPixels[pixelIndex] = cachedPixel.color;
+			if (m_DenoiserEnabled)
+				m_Denoiser.WriteGuide(pixelIndex, cachedPixel.normal, cachedPixel.depth, cachedPixel.albedo);
+			else
+				WriteBackBufferPixel(pixelIndex, cachedPixel.color);
+		}
+	}
+
+	//traced pixels overwrite their entry while rendering
+	m_Cache.swap(m_ReprojectedCache);
+
+	return tracePixels;
+}
+
+void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin, const ObjectCandidates* pCandidates)
+{
+	const uint32_t px{ pixelIndex % m_RenderWidth }, py{ pixelIndex / m_RenderWidth };
+
+	PrimarySample sample{};
+	TracePrimaryRay(pScene, px, py, fov, aspectRatio, cameraToWorld, cameraOrigin, sample, pCandidates);
+	WritePixel(pScene, pixelIndex, sample);
+}
+
+void Renderer::RenderTiles(Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	const int tilesX{ (x1 - x0 + TileSize - 1) / TileSize };
+	const int tilesY{ (y1 - y0 + TileSize - 1) / TileSize };
+
+	std::vector<uint32_t> tileIndices(std::max(0, tilesX * tilesY));
+	std::iota(tileIndices.begin(), tileIndices.end(), 0);
+
+	const auto renderTile = [&](uint32_t tileIndex)
+		{
+			const int tileX{ x0 + static_cast<int>(tileIndex % tilesX) * TileSize };
+			const int tileY{ y0 + static_cast<int>(tileIndex / tilesX) * TileSize };
+			RenderTile(pScene, tileX, tileY, std::min(tileX + TileSize, x1), std::min(tileY + TileSize, y1), fov, aspectRatio, cameraToWorld, cameraOrigin);
+		};
+
+#if defined(PARALLEL_EXECUTION)
+	//offscreen renderers run one per core, so their frames are already parallel
+	if (!m_IsOffscreen)
 	{
-		RenderPixel(pScene, i, FOV, aspectRatio, cameraToWorld, camera.origin);
+		std::for_each(std::execution::par, tileIndices.begin(), tileIndices.end(), renderTile);
+		return;
 	}
 #endif
+	std::for_each(tileIndices.begin(), tileIndices.end(), renderTile);
+}
 
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+void Renderer::RenderTile(Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	thread_local ObjectCandidates candidates{};
+	CullObjects(pScene, x0, y0, x1, y1, fov, aspectRatio, cameraToWorld, cameraOrigin, candidates);
+
+	for (int py = y0; py < y1; ++py)
+	{
+		for (int px = x0; px < x1; ++px)
+		{
+			RenderPixel(pScene, px + py * m_RenderWidth, fov, aspectRatio, cameraToWorld, cameraOrigin, &candidates);
+		}
+	}
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin) const
+void Renderer::CullObjects(const Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+	ObjectCandidates& candidates) const
 {
-	auto materials{ pScene->GetMaterials() };
-	auto& lights{ pScene->GetLights() };
+	//the pixel edges of the rectangle, jittered path tracing rays stay inside them
+	const Vector3 corners[4]{
+		GetCameraRayDirection(float(x0), float(y0), fov, aspectRatio, cameraToWorld),
+		GetCameraRayDirection(float(x1), float(y0), fov, aspectRatio, cameraToWorld),
+		GetCameraRayDirection(float(x1), float(y1), fov, aspectRatio, cameraToWorld),
+		GetCameraRayDirection(float(x0), float(y1), fov, aspectRatio, cameraToWorld) };
 
-	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+	Frustum frustum{};
+	frustum.Build(cameraOrigin, corners);
+	pScene->CullObjects(frustum, candidates);
+}
 
-	float rx{ px + 0.5f },ry{py + 0.5f};
-	float cx{ (2 * (rx / float(m_Width)) - 1) * aspectRatio * fov };
-	float cy{ (1 - (2 * (ry / float(m_Height)))) * fov };
+Vector3 Renderer::GetCameraRayDirection(float x, float y, float fov, float aspectRatio, const Matrix& cameraToWorld) const
+{
+	float cx{ (2 * (x / float(m_RenderWidth)) - 1) * aspectRatio * fov };
+	float cy{ (1 - (2 * (y / float(m_RenderHeight)))) * fov };
+
+	return cameraToWorld.TransformVector({ cx,cy,1 });
+}
 
-	Vector3 rayDirectionWS{ cameraToWorld.TransformVector({cx,cy,1}) };
+void Renderer::TracePrimaryRay(Scene* pScene, int px, int py, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, PrimarySample& sample,
+	const ObjectCandidates* pCandidates)
+{
+	//one generator per pixel and frame, every accumulated frame gets other samples
+	Sampling::Random random{ uint32_t(px + py * m_RenderWidth) * 0x9E3779B9u ^ m_FrameCounter * 0x85EBCA6Bu };
+
+	float rx{ px + 0.5f },ry{py + 0.5f};
+	//path tracing jitters the ray inside the pixel, accumulating the frames anti-aliases the image
+	if (m_PathTracingEnabled)
+	{
+		rx = px + random.Next();
+		ry = py + random.Next();
+	}
+	Vector3 rayDirectionWS{ GetCameraRayDirection(rx, ry, fov, aspectRatio, cameraToWorld) };
 
 	Ray viewRay{ cameraOrigin,rayDirectionWS.Normalized() };
+	sample.viewDirection = viewRay.direction;
+	sample.shadowState = 0;
 
-	HitRecord closestHit{ };
+	HitRecord& closestHit{ sample.hit };
 
-	pScene->GetClosestHit(viewRay, closestHit);
+	if (pCandidates)
+		pScene->GetClosestHit(viewRay, closestHit, *pCandidates);
+	else
+		pScene->GetClosestHit(viewRay, closestHit);
 
 	//black BackGround
+	ColorRGB& finalColor{ sample.color };
+	finalColor = {};
+
+	//rays per bounce depth of this pixel, added to the frame totals once
+	uint32_t rayCounts[MaxBounceDepth + 1]{ 1 };
+
+	if (closestHit.didHit && m_PathTracingEnabled)
+	{
+		finalColor = TracePath(pScene, closestHit, viewRay.direction, random, rayCounts);
+	}
+	else if (closestHit.didHit)
+	{
+		const int shadowSamples{ GetShadowBudget(px, py) };
+		finalColor += ShadeDirect(pScene, closestHit, viewRay.direction, random, shadowSamples, sample.shadowState);
+		if (shadowSamples > 1)
+			sample.shadowState |= FullShadowBudgetBit;
+
+		//Mirror and glass, secondary rays are followed with an explicit stack instead of recursion
+		thread_local std::vector<SecondaryRay> rayStack{};
+		rayStack.clear();
+		PushSecondaryRays(pScene, closestHit, viewRay.direction, ColorRGB{ 1.f, 1.f, 1.f }, 1, rayStack);
+
+		while (!rayStack.empty())
+		{
+			const SecondaryRay secondaryRay{ rayStack.back() };
+			rayStack.pop_back();
+			++rayCounts[secondaryRay.depth];
+
+			HitRecord hit{};
+			pScene->GetClosestHit(secondaryRay.ray, hit);
+			if (!hit.didHit)
+				continue;
+
+			//reflections only take one shadow ray per light, the pixel budget is for what is seen directly
+			uint32_t shadowState{};
+			finalColor += secondaryRay.throughput * ShadeDirect(pScene, hit, secondaryRay.ray.direction, random, 1, shadowState);
+			PushSecondaryRays(pScene, hit, secondaryRay.ray.direction, secondaryRay.throughput, secondaryRay.depth + 1, rayStack);
+		}
+	}
+
+	for (int depth = 0; depth <= MaxBounceDepth; ++depth)
+	{
+		if (rayCounts[depth] > 0)
+			m_RayCounts[depth].fetch_add(rayCounts[depth], std::memory_order_relaxed);
+	}
+}
+
+ColorRGB Renderer::ShadeDirect(Scene* pScene, const HitRecord& closestHit, const Vector3& rayDirection, Sampling::Random& random, int shadowSamples, uint32_t& shadowState) const
+{
+	const std::vector<Material*>& materials{ pScene->GetMaterials() };
+	auto& lights{ pScene->GetLights() };
+
+	//path tracing always needs the full, shadowed lighting
+	const bool castShadows{ m_ShadowsEnabled || m_PathTracingEnabled };
+	const LightingMode lightingMode{ m_PathTracingEnabled ? LightingMode::Combined : m_CurrentLightingMode };
+
 	ColorRGB finalColor{};
 
-	if (closestHit.didHit)
+	const Vector3 hitPointOffset{ closestHit.origin + closestHit.normal * 0.001f };
+	const Vector3 v{ -rayDirection };
+	//adding shadows
+	for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
 	{
-		const Vector3 hitPointOffset{ closestHit.origin + closestHit.normal * 0.001f };
-		const Vector3 v{ -viewRay.direction };
-		//adding shadows
-		for (const Light& light : lights)
+		const Light& light{ lights[lightIndex] };
+		const bool isAreaLight{ LightUtils::IsAreaLight(light) };
+
+		//Path tracing takes one random point of an area light per vertex, otherwise the shadow budget is spread over
+		//strata of the light. A single sample uses the center, so fully lit and fully shadowed pixels have no noise
+		const int sampleCount{ isAreaLight && !m_PathTracingEnabled ? shadowSamples : 1 };
+		const int strata{ static_cast<int>(sqrtf(static_cast<float>(sampleCount))) };
+		ColorRGB lightColor{};
+		int litSamples{ 0 };
+
+		for (int sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
 		{
-			Vector3 rayToLight{ LightUtils::GetDirectionToLight(light, hitPointOffset) };
+			Vector3 lightPoint{ light.origin };
+			if (isAreaLight && m_PathTracingEnabled)
+			{
+				lightPoint = LightUtils::SampleLightPoint(light, hitPointOffset, random.Next(), random.Next());
+			}
+			else if (isAreaLight && sampleCount > 1)
+			{
+				lightPoint = LightUtils::SampleLightPoint(light, hitPointOffset,
+					(sampleIndex % strata + random.Next()) / strata,
+					(sampleIndex / strata + random.Next()) / strata);
+			}
+
+			Vector3 rayToLight{ isAreaLight ? lightPoint - hitPointOffset : LightUtils::GetDirectionToLight(light, hitPointOffset) };
 			float distanceToLight{ rayToLight.Magnitude() };
 			Vector3 l = rayToLight.Normalized();
 
 			//Create HardShadow
-			if (m_ShadowsEnabled)
+			if (castShadows)
 			{
 				Ray shadowRay(hitPointOffset, rayToLight.Normalized(), 0.001f, distanceToLight - 0.001f);
 				if (pScene->DoesHit(shadowRay))
@@ -106,45 +658,412 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 				}
 
 			}
+			++litSamples;
+
 			const float cosineLaw = std::max(0.f, Vector3::Dot(closestHit.normal, l));
+			const ColorRGB radiance{ isAreaLight ?
+				LightUtils::GetRadiance(light, lightPoint, closestHit.origin) :
+				LightUtils::GetRadiance(light, closestHit.origin) };
 
-			switch (m_CurrentLightingMode)
+			ColorRGB sampleColor{};
+			switch (lightingMode)
 			{
 			case LightingMode::ObservedArea:
-				finalColor += ColorRGB(1.f, 1.f, 1.f) * cosineLaw;
+				sampleColor = ColorRGB(1.f, 1.f, 1.f) * cosineLaw;
 				break;
 			case LightingMode::Radiance:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin);
+				sampleColor = radiance;
 				break;
 			case LightingMode::BRDF:
-				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, l, v);
+				sampleColor = materials[closestHit.materialIndex]->Shade(closestHit, l, v);
 				break;
 			case LightingMode::Combined:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin)
+				sampleColor = radiance
 					* materials[closestHit.materialIndex]->Shade(closestHit, l, v)
 					* cosineLaw;
 				break;
 			}
+
+			//BRDF samples of the path tracer can hit area lights too, both techniques are weighted with MIS
+			if (isAreaLight && m_PathTracingEnabled)
+			{
+				sampleColor *= Sampling::PowerHeuristic(LightUtils::GetLightPdf(light, lightPoint, closestHit.origin),
+					materials[closestHit.materialIndex]->GetPdf(closestHit, l, v));
+			}
+
+			lightColor += sampleColor;
+		}
+
+		finalColor += lightColor * (1.f / sampleCount);
+
+		//which area lights are visible, partly visible or hidden, input of the penumbra detection
+		if (castShadows && isAreaLight && lightIndex < MaxPenumbraLights)
+		{
+			if (litSamples > 0)
+				shadowState |= 1u << (2 * lightIndex);
+			if (litSamples < sampleCount)
+				shadowState |= 1u << (2 * lightIndex + 1);
+		}
+	}
+
+	return finalColor;
+}
+
+ColorRGB Renderer::TracePath(Scene* pScene, const HitRecord& primaryHit, const Vector3& primaryDirection, Sampling::Random& random, uint32_t* rayCounts) const
+{
+	const std::vector<Material*>& materials{ pScene->GetMaterials() };
+
+	ColorRGB radiance{};
+	ColorRGB throughput{ 1.f, 1.f, 1.f };
+	HitRecord hit{ primaryHit };
+	Vector3 rayDirection{ primaryDirection };
+
+	for (int bounce = 0; bounce < MaxPathDepth; ++bounce)
+	{
+		const Material* pMaterial{ materials[hit.materialIndex] };
+		const Vector3 v{ -rayDirection };
+		Vector3 direction{};
+		//pdf of the BRDF sample, 0 after mirror and glass where no light sample competes with it
+		float brdfPdf{ 0.f };
+
+		const SpecularBounce specularBounce{ pMaterial->GetSpecularBounce(hit, v) };
+		const float reflectWeight{ std::max({ specularBounce.reflectance.r, specularBounce.reflectance.g, specularBounce.reflectance.b }) };
+		const float refractWeight{ std::max({ specularBounce.transmittance.r, specularBounce.transmittance.g, specularBounce.transmittance.b }) };
+
+		if (reflectWeight + refractWeight > 0.f)
+		{
+			//Mirror and glass, follow either the reflection or the refraction with a probability by their weight
+			const float reflectProbability{ reflectWeight / (reflectWeight + refractWeight) };
+			if (random.Next() < reflectProbability)
+			{
+				direction = specularBounce.reflectDirection;
+				throughput *= specularBounce.reflectance * (1.f / reflectProbability);
+			}
+			else
+			{
+				direction = specularBounce.refractDirection;
+				throughput *= specularBounce.transmittance * (1.f / (1.f - reflectProbability));
+			}
+		}
+		else
+		{
+			//Next event estimation, point and directional lights can't be hit by BRDF samples so their MIS weight is 1
+			uint32_t shadowState{};
+			radiance += throughput * ShadeDirect(pScene, hit, rayDirection, random, 1, shadowState);
+
+			//Continue along a direction importance sampled from the BRDF
+			direction = pMaterial->SampleDirection(hit, v, random.Next(), random.Next(), random.Next());
+			const float cosine{ Vector3::Dot(hit.normal, direction) };
+			brdfPdf = pMaterial->GetPdf(hit, direction, v);
+			if (cosine <= 0.f || brdfPdf <= 0.f)
+				break;
+
+			throughput *= materials[hit.materialIndex]->Shade(hit, direction, v) * (cosine / brdfPdf);
 		}
+
+		//Russian roulette, paths that carry little light end early, survivors are weighted up to stay unbiased
+		if (bounce >= RouletteStartDepth)
+		{
+			const float survivalProbability{ std::min(0.95f, std::max({ throughput.r, throughput.g, throughput.b })) };
+			if (random.Next() >= survivalProbability)
+				break;
+			throughput *= 1.f / survivalProbability;
+		}
+
+		const float side{ Vector3::Dot(direction, hit.normal) < 0.f ? -1.f : 1.f };
+		const Ray ray{ hit.origin + hit.normal * (0.001f * side), direction };
+		++rayCounts[std::min(bounce + 1, MaxBounceDepth)];
+
+		const Vector3 previousVertex{ hit.origin };
+		hit = {};
+		pScene->GetClosestHit(ray, hit);
+
+		//Area lights in front of the next surface, MIS weighted against the light sample of the previous vertex
+		for (const Light& light : pScene->GetLights())
+		{
+			float lightT{};
+			if (!LightUtils::IsAreaLight(light) || !LightUtils::HitTest_Light(light, ray, lightT) || lightT >= hit.t)
+				continue;
+
+			const float misWeight{ brdfPdf > 0.f ?
+				Sampling::PowerHeuristic(brdfPdf, LightUtils::GetLightPdf(light, ray.origin + ray.direction * lightT, previousVertex)) :
+				1.f };
+			radiance += throughput * LightUtils::GetEmittedRadiance(light) * misWeight;
+		}
+
+		//black background, nothing to add
+		if (!hit.didHit)
+			break;
+
+		rayDirection = direction;
+	}
+
+	return radiance;
+}
+
+void Renderer::PushSecondaryRays(Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const ColorRGB& throughput, int depth, std::vector<SecondaryRay>& rayStack) const
+{
+	if (depth > MaxBounceDepth)
+		return;
+
+	const SpecularBounce bounce{ pScene->GetMaterials()[hit.materialIndex]->GetSpecularBounce(hit, -rayDirection) };
+
+	//rays that can't change the pixel noticeably anymore are not traced
+	auto push = [&](const ColorRGB& weight, const Vector3& direction)
+		{
+			const ColorRGB rayThroughput{ throughput * weight };
+			if (std::max({ rayThroughput.r, rayThroughput.g, rayThroughput.b }) < MinThroughput)
+				return;
+
+			//start on the side of the surface the ray leaves to
+			const float side{ Vector3::Dot(direction, hit.normal) < 0.f ? -1.f : 1.f };
+			rayStack.push_back({ Ray{ hit.origin + hit.normal * (0.001f * side), direction }, rayThroughput, depth });
+		};
+
+	push(bounce.reflectance, bounce.reflectDirection);
+	push(bounce.transmittance, bounce.refractDirection);
+}
+
+void Renderer::WritePixel(Scene* pScene, uint32_t pixelIndex, const PrimarySample& sample)
+{
+	const HitRecord& closestHit{ sample.hit };
+	ColorRGB finalColor{ sample.color };
+
+	if (m_DenoiserEnabled)
+	{
+		if (closestHit.didHit)
+			m_Denoiser.WriteGuide(pixelIndex, closestHit.normal, closestHit.t, pScene->GetMaterials()[closestHit.materialIndex]->GetAlbedo());
+		else
+			m_Denoiser.WriteEmptyGuide(pixelIndex);
 	}
 
+	//reduced resolution frames are upscaled afterwards
+	if (m_RenderWidth != m_Width || m_RenderHeight != m_Height)
+	{
+		m_ScaledPixels[pixelIndex] = finalColor;
+		m_ShadowStates[pixelIndex] = sample.shadowState;
+		return;
+	}
+
+	//progressive path tracing shows the average of all samples so far
+	if (m_PathTracingEnabled)
+	{
+		ColorRGB& accumulated{ m_AccumulatedPixels[pixelIndex] };
+		accumulated = m_AccumulatedSamples == 0 ? sample.color : accumulated + sample.color;
+		finalColor = accumulated * (1.f / (m_AccumulatedSamples + 1));
+	}
+
+	m_HdrPixels[pixelIndex] = finalColor;
+	m_ShadowStates[pixelIndex] = sample.shadowState;
+
+	if (m_ReprojectionEnabled)
+	{
+		CachedPixel& cachedPixel{ m_Cache[pixelIndex] };
+		cachedPixel.position = closestHit.origin;
+		cachedPixel.normal = closestHit.normal;
+		cachedPixel.viewDirection = sample.viewDirection;
+		cachedPixel.color = finalColor;
+		cachedPixel.albedo = closestHit.didHit ? pScene->GetMaterials()[closestHit.materialIndex]->GetAlbedo() : ColorRGB{};
+		cachedPixel.depth = closestHit.t;
+		cachedPixel.didHit = closestHit.didHit;
+		cachedPixel.isValid = true;
+	}
+
+	//the back buffer is written once the frame is denoised
+	if (m_DenoiserEnabled)
+		return;
+
 	//Update Color in Buffer
-	finalColor.MaxToOne();
+	WriteBackBufferPixel(pixelIndex, finalColor);
+}
+
+void Renderer::RenderAdaptive(Scene* pScene, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	const int blocksX{ (m_RenderWidth + AdaptiveBlockSize - 1) / AdaptiveBlockSize };
+	const int blocksY{ (m_RenderHeight + AdaptiveBlockSize - 1) / AdaptiveBlockSize };
+
+	std::vector<uint32_t> blockIndices(blocksX * blocksY);
+	std::iota(blockIndices.begin(), blockIndices.end(), 0);
+
+	std::for_each(std::execution::par, blockIndices.begin(), blockIndices.end(), [&](uint32_t blockIndex) {
+		RenderAdaptiveBlock(pScene, (blockIndex % blocksX) * AdaptiveBlockSize, (blockIndex / blocksX) * AdaptiveBlockSize,
+			fov, aspectRatio, cameraToWorld, cameraOrigin);
+		});
+}
+
+void Renderer::RenderAdaptiveBlock(Scene* pScene, int blockX, int blockY, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	//Samples sit on the pixel centers of the block corners, the right and bottom ones belong to the next block.
+	//Those are traced by both blocks, sharing them would need a sync between neighbouring blocks.
+	constexpr int GridSize{ AdaptiveBlockSize + 1 };
+	PrimarySample samples[GridSize * GridSize];
+	bool isTraced[GridSize * GridSize]{};
+
+	thread_local ObjectCandidates candidates{};
+	CullObjects(pScene, blockX, blockY, blockX + GridSize, blockY + GridSize, fov, aspectRatio, cameraToWorld, cameraOrigin, candidates);
+
+	auto getSample = [&](int x, int y) -> const PrimarySample&
+		{
+			const int gridIndex{ x + y * GridSize };
+			if (!isTraced[gridIndex])
+			{
+				TracePrimaryRay(pScene, blockX + x, blockY + y, fov, aspectRatio, cameraToWorld, cameraOrigin, samples[gridIndex], &candidates);
+				isTraced[gridIndex] = true;
+			}
+			return samples[gridIndex];
+		};
+
+	struct SubBlock
+	{
+		int x;
+		int y;
+		int size;
+	};
+
+	//depth first, at most 3 siblings per level are waiting
+	SubBlock subBlocks[16]{ { 0, 0, AdaptiveBlockSize } };
+	int subBlockCount{ 1 };
+
+	while (subBlockCount > 0)
+	{
+		const SubBlock subBlock{ subBlocks[--subBlockCount] };
+		const int size{ subBlock.size };
+
+		//nothing of it is on screen
+		if (blockX + subBlock.x >= m_RenderWidth || blockY + subBlock.y >= m_RenderHeight)
+			continue;
+
+		const PrimarySample& topLeft{ getSample(subBlock.x, subBlock.y) };
+
+		if (size == 1)
+		{
+			WritePixel(pScene, (blockX + subBlock.x) + (blockY + subBlock.y) * m_RenderWidth, topLeft);
+			continue;
+		}
+
+		const PrimarySample& topRight{ getSample(subBlock.x + size, subBlock.y) };
+		const PrimarySample& bottomLeft{ getSample(subBlock.x, subBlock.y + size) };
+		const PrimarySample& bottomRight{ getSample(subBlock.x + size, subBlock.y + size) };
+
+		if (!CanInterpolate(topLeft, topRight) || !CanInterpolate(topLeft, bottomLeft) || !CanInterpolate(topLeft, bottomRight))
+		{
+			const int halfSize{ size / 2 };
+			subBlocks[subBlockCount++] = { subBlock.x, subBlock.y, halfSize };
+			subBlocks[subBlockCount++] = { subBlock.x + halfSize, subBlock.y, halfSize };
+			subBlocks[subBlockCount++] = { subBlock.x, subBlock.y + halfSize, halfSize };
+			subBlocks[subBlockCount++] = { subBlock.x + halfSize, subBlock.y + halfSize, halfSize };
+			continue;
+		}
+
+		//Bilinear interpolation of the corners, the hit is interpolated as well so guides and cache stay usable
+		for (int y = 0; y < size && blockY + subBlock.y + y < m_RenderHeight; ++y)
+		{
+			const float fy{ static_cast<float>(y) / size };
+			for (int x = 0; x < size && blockX + subBlock.x + x < m_RenderWidth; ++x)
+			{
+				const float fx{ static_cast<float>(x) / size };
+
+				PrimarySample sample{ topLeft };
+				sample.color = ColorRGB::Lerp(
+					ColorRGB::Lerp(topLeft.color, topRight.color, fx),
+					ColorRGB::Lerp(bottomLeft.color, bottomRight.color, fx), fy);
+
+				const float topLeftWeight{ (1.f - fx) * (1.f - fy) };
+				const float topRightWeight{ fx * (1.f - fy) };
+				const float bottomLeftWeight{ (1.f - fx) * fy };
+				const float bottomRightWeight{ fx * fy };
+
+				sample.viewDirection = (topLeft.viewDirection * topLeftWeight + topRight.viewDirection * topRightWeight
+					+ bottomLeft.viewDirection * bottomLeftWeight + bottomRight.viewDirection * bottomRightWeight).Normalized();
+
+				if (topLeft.hit.didHit)
+				{
+					sample.hit.origin = topLeft.hit.origin * topLeftWeight + topRight.hit.origin * topRightWeight
+						+ bottomLeft.hit.origin * bottomLeftWeight + bottomRight.hit.origin * bottomRightWeight;
+					sample.hit.normal = (topLeft.hit.normal * topLeftWeight + topRight.hit.normal * topRightWeight
+						+ bottomLeft.hit.normal * bottomLeftWeight + bottomRight.hit.normal * bottomRightWeight).Normalized();
+					sample.hit.t = topLeft.hit.t * topLeftWeight + topRight.hit.t * topRightWeight
+						+ bottomLeft.hit.t * bottomLeftWeight + bottomRight.hit.t * bottomRightWeight;
+				}
+
+				WritePixel(pScene, (blockX + subBlock.x + x) + (blockY + subBlock.y + y) * m_RenderWidth, sample);
+			}
+		}
+	}
+}
+
+bool Renderer::CanInterpolate(const PrimarySample& a, const PrimarySample& b)
+{
+	constexpr float MaxColorDifference{ 0.05f };
+
+	if (a.hit.didHit != b.hit.didHit)
+		return false;
+
+	//background
+	if (!a.hit.didHit)
+		return true;
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	if (a.hit.objectIndex != b.hit.objectIndex || a.hit.primitiveIndex != b.hit.primitiveIndex || a.hit.materialIndex != b.hit.materialIndex)
+		return false;
 
+	//a shadow edge between the samples
+	if ((a.shadowState & ~FullShadowBudgetBit) != (b.shadowState & ~FullShadowBudgetBit))
+		return false;
+
+	//shadow borders and highlights inside one primitive, relative to the brightness for HDR values
+	const float brightness{ std::max({ 1.f, a.color.r, a.color.g, a.color.b, b.color.r, b.color.g, b.color.b }) };
+	return std::abs(a.color.r - b.color.r) <= MaxColorDifference * brightness
+		&& std::abs(a.color.g - b.color.g) <= MaxColorDifference * brightness
+		&& std::abs(a.color.b - b.color.b) <= MaxColorDifference * brightness;
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::ToggleAdaptiveSampling()
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	m_AdaptiveSamplingEnabled = !m_AdaptiveSamplingEnabled;
+	m_IsDirty = true;
+
+	std::cout << (m_AdaptiveSamplingEnabled ? "Adaptive sampling on\n" : "Adaptive sampling off\n");
+}
+
+void Renderer::SaveBufferToImage(ImageWriter& imageWriter, const std::string& fileName, ImageFormat format) const
+{
+	std::vector<ColorRGB> pixels{};
+	{
+		std::lock_guard lock{ m_PresentMutex };
+		pixels = m_FrontHdrPixels;
+	}
+
+	//encoding and disk access happen on the writer thread
+	imageWriter.Save(std::move(pixels), m_Width, m_Height, fileName, format);
+}
+
+void Renderer::SetRenderRegion(int x, int y, int width, int height)
+{
+	m_RegionX = std::clamp(x, 0, m_Width);
+	m_RegionY = std::clamp(y, 0, m_Height);
+	m_RegionWidth = std::clamp(width, 0, m_Width - m_RegionX);
+	m_RegionHeight = std::clamp(height, 0, m_Height - m_RegionY);
+
+	//shadow states outside the region are from another tile, zero is ignored by the penumbra detection
+	std::fill(m_ShadowStates.begin(), m_ShadowStates.end(), 0u);
+	//path traced samples of the last region don't belong to this one
+	m_IsDirty = true;
+}
+
+void Renderer::CopyRegion(int x, int y, int width, int height, ColorRGB* pDestination) const
+{
+	std::lock_guard lock{ m_PresentMutex };
+	for (int row = 0; row < height; ++row)
+	{
+		const auto rowStart{ m_FrontHdrPixels.begin() + (x + (y + row) * m_Width) };
+		std::copy(rowStart, rowStart + width, pDestination + row * width);
+	}
 }
 
 void dae::Renderer::CycleLightingMode()
 {
+	m_IsDirty = true;
+
 	std::cout << std::endl;
 	switch (m_CurrentLightingMode)
 	{
@@ -1,8 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <cfloat>
 #include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "ColorRGB.h"
+#include "DataTypes.h"
+#include "Denoiser.h"
+#include "ImageWriter.h"
 #include "Matrix.h"
+#include "ResolutionController.h"
+#include "Sampling.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -10,27 +21,104 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
+	struct ObjectCandidates;
 
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Offscreen renderer for batch rendering: full resolution, pixels traced on the calling thread
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScne, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin) const;
+		void Render(Scene* pScene);
+		void RenderPixel(Scene* pScne, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin, const ObjectCandidates* pCandidates = nullptr);
 
-		bool SaveBufferToImage() const;
+		//Copies the last finished frame to the window, only call from the thread that owns the window
+		bool Present();
+		//Copies the last finished frame (unclamped radiance) and queues it on the writer thread
+		void SaveBufferToImage(ImageWriter& imageWriter, const std::string& fileName, ImageFormat format = ImageFormat::PNG) const;
+
+		//Offscreen only: frames only trace this rectangle, the rest of the buffers keeps what it had
+		void SetRenderRegion(int x, int y, int width, int height);
+		//Copies a rectangle of the last finished frame (unclamped radiance), rows are tightly packed
+		void CopyRegion(int x, int y, int width, int height, ColorRGB* pDestination) const;
 
 		void CycleLightingMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; m_IsDirty = true; }
+
+		void ToggleDynamicResolution();
+		void ToggleDenoiser();
+		void ToggleReprojection();
+		void ToggleAdaptiveSampling();
+		void TogglePathTracing();
+		//frame time of the last rendered frame, drives the dynamic resolution controller
+		void ReportFrameTime(float frameTime);
+
+		//true when the camera, a mesh transform or a renderer toggle changed since the last frame
+		bool NeedsRender(const Scene* pScene) const;
+
+		//rays traced per bounce depth (0 = primary) in the last frame
+		void PrintRayCounts() const;
 
 	private:
+		struct PrimarySample
+		{
+			ColorRGB color{};
+			HitRecord hit{};
+			Vector3 viewDirection{};
+			uint32_t shadowState{};	//per area light: lit and shadowed bits, input of the penumbra mask
+		};
+
+		struct SecondaryRay
+		{
+			Ray ray{};
+			ColorRGB throughput{};	//how much of the light along the ray reaches the pixel
+			int depth{};
+		};
+
+		//the candidates limit what the primary ray is tested against, secondary rays always see the whole scene
+		void TracePrimaryRay(Scene* pScene, int px, int py, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, PrimarySample& sample,
+			const ObjectCandidates* pCandidates = nullptr);
+		//world space direction through a point of the render resolution screen, not normalized
+		Vector3 GetCameraRayDirection(float x, float y, float fov, float aspectRatio, const Matrix& cameraToWorld) const;
+
+		//Splits [x0, x1) x [y0, y1) in tiles, traced in parallel unless the renderer is offscreen
+		void RenderTiles(Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		//Traces the pixels [x0, x1) x [y0, y1) against the objects inside the frustum of the rectangle
+		void RenderTile(Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		void CullObjects(const Scene* pScene, int x0, int y0, int x1, int y1, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin,
+			ObjectCandidates& candidates) const;
+		//lights and shadows at a hit, seen along rayDirection, area lights take shadowSamples stratified shadow rays
+		ColorRGB ShadeDirect(Scene* pScene, const HitRecord& closestHit, const Vector3& rayDirection, Sampling::Random& random, int shadowSamples, uint32_t& shadowState) const;
+		//Global illumination, next event estimation at every diffuse or glossy vertex and BRDF importance sampled bounces
+		ColorRGB TracePath(Scene* pScene, const HitRecord& primaryHit, const Vector3& primaryDirection, Sampling::Random& random, uint32_t* rayCounts) const;
+		void PushSecondaryRays(Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const ColorRGB& throughput, int depth, std::vector<SecondaryRay>& rayStack) const;
+		//stores a traced or interpolated sample in the frame buffers, the denoiser guides and the reprojection cache
+		void WritePixel(Scene* pScene, uint32_t pixelIndex, const PrimarySample& sample);
+
+		//Adaptive sampling, traces the corners of 8x8 blocks and only subdivides blocks whose corners don't agree
+		void RenderAdaptive(Scene* pScene, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		void RenderAdaptiveBlock(Scene* pScene, int blockX, int blockY, float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		//same primitive and material with similar shading
+		static bool CanInterpolate(const PrimarySample& a, const PrimarySample& b);
+
+		//Soft shadows, pixels near a penumbra of the last frame get the full shadow budget, the rest one ray per light
+		int GetShadowBudget(int px, int py) const;
+		void UpdatePenumbraMask(const Scene* pScene);
+
+		void UpscaleToBackBuffer();
+		void HdrToBackBuffer();
+		void WriteBackBufferPixel(uint32_t pixelIndex, ColorRGB color);
+
+		//Moves last frame's shading to where the new camera sees it, returns the pixels that still have to be traced
+		std::vector<uint32_t> ReprojectCache(float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+
 		enum class LightingMode
 		{
 			ObservedArea,	//Lambert cosine law
@@ -41,13 +129,97 @@ namespace dae
 
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ false };
+		bool m_IsDirty{ true };
 
 		SDL_Window* m_pWindow{};
+		bool m_IsOffscreen{ false };
+		//render region of offscreen frames, the whole frame unless a tile is set
+		int m_RegionX{ 0 };
+		int m_RegionY{ 0 };
+		int m_RegionWidth{};
+		int m_RegionHeight{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
 
+		//frames are traced into the back buffer and handed to the window surface once finished
+		std::vector<uint32_t> m_BackBufferPixels{};
+		//unclamped radiance of the frame being traced and of the last finished one, used for image output
+		std::vector<ColorRGB> m_HdrPixels{};
+		std::vector<ColorRGB> m_FrontHdrPixels{};
+		mutable std::mutex m_PresentMutex{};
+		bool m_HasNewFrame{ false };
+
 		int m_Width{};
 		int m_Height{};
+
+		//Progressive resolution, frames are traced at m_RenderScale of the window and upscaled
+		float m_MotionRenderScale{ 0.25f };
+		float m_RenderScale{ 1.f };
+		int m_RenderWidth{};
+		int m_RenderHeight{};
+		std::vector<ColorRGB> m_ScaledPixels{};
+
+		//Dynamic resolution, changing frames use the controller scale to hold the target frame time
+		ResolutionController m_ResolutionController{ 0.033f };
+		bool m_DynamicResolutionEnabled{ false };
+		bool m_IsDynamicResolutionFrame{ false };
+
+		//Denoiser, guides are written while tracing and the frame is filtered before it reaches the back buffer
+		Denoiser m_Denoiser{};
+		bool m_DenoiserEnabled{ false };
+
+		//Temporal reprojection, small camera moves reuse last frame's shading and only trace what can't be reused
+		struct CachedPixel
+		{
+			Vector3 position{};
+			Vector3 normal{};
+			Vector3 viewDirection{};	//direction the pixel was traced from
+			ColorRGB color{};
+			ColorRGB albedo{};
+			float depth{ FLT_MAX };		//distance to the camera of the frame it belongs to
+			bool didHit{ false };
+			bool isValid{ false };
+		};
+
+		std::vector<CachedPixel> m_Cache{};
+		std::vector<CachedPixel> m_ReprojectedCache{};
+		bool m_ReprojectionEnabled{ false };
+		bool m_HasValidCache{ false };
+		bool m_IsReprojectedFrame{ false };
+		uint32_t m_FrameCounter{ 0 };
+
+		//Reflections and refractions, a secondary ray is only traced when both limits allow it
+		static constexpr int MaxBounceDepth{ 5 };
+		static constexpr float MinThroughput{ 0.01f };
+		std::atomic<uint32_t> m_RayCounts[MaxBounceDepth + 1]{};
+		uint32_t m_LastFrameRayCounts[MaxBounceDepth + 1]{};
+
+		//Path tracing, frames are averaged while nothing changes
+		static constexpr int MaxPathDepth{ 8 };
+		static constexpr int RouletteStartDepth{ 3 };
+		static constexpr uint32_t MaxAccumulatedSamples{ 1024 };
+		bool m_PathTracingEnabled{ false };
+		uint32_t m_AccumulatedSamples{ 0 };
+		std::vector<ColorRGB> m_AccumulatedPixels{};
+
+		//Area lights, shadow states hold two bits per light so only the first lights take part in penumbra detection
+		static constexpr int MaxShadowSamples{ 16 };
+		static constexpr size_t MaxPenumbraLights{ 15 };
+		static constexpr uint32_t FullShadowBudgetBit{ 1u << 31 };
+		static constexpr int PenumbraRadius{ 2 };
+		static constexpr int MaxShadowRefinements{ 2 };
+		std::vector<uint32_t> m_ShadowStates{};
+		std::vector<uint8_t> m_PenumbraMask{};
+		int m_PenumbraWidth{ 0 };
+		int m_PenumbraHeight{ 0 };
+		bool m_NeedsShadowRefinement{ false };
+		int m_ShadowRefinements{ 0 };
+
+		//Frames are traced in tiles, each with its own frustum culled list of objects
+		static constexpr int TileSize{ 16 };
+
+		static constexpr int AdaptiveBlockSize{ 8 };
+		bool m_AdaptiveSamplingEnabled{ false };
 	};
 }
@@ -0,0 +1,47 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	//Picks the internal render scale so a frame takes about the target frame time.
+	//Tracing cost grows with the pixel count, so frame times are normalized by scale^2 before averaging.
+	class ResolutionController final
+	{
+	public:
+		ResolutionController(float targetFrameTime = 1.f / 30.f, float minScale = 0.25f, float maxScale = 1.f) :
+			m_TargetFrameTime(targetFrameTime), m_MinScale(minScale), m_MaxScale(maxScale), m_Scale(maxScale)
+		{}
+
+		//frameTime has to be measured for a frame rendered at GetScale()
+		void Update(float frameTime)
+		{
+			const float fullResolutionTime{ frameTime / (m_Scale * m_Scale) };
+
+			m_AverageFullResolutionTime = m_AverageFullResolutionTime <= 0.f ?
+				fullResolutionTime :
+				m_AverageFullResolutionTime + (fullResolutionTime - m_AverageFullResolutionTime) * Smoothing;
+
+			m_Scale = std::clamp(std::sqrt(m_TargetFrameTime / m_AverageFullResolutionTime), m_MinScale, m_MaxScale);
+		}
+
+		void Reset()
+		{
+			m_Scale = m_MaxScale;
+			m_AverageFullResolutionTime = 0.f;
+		}
+
+		float GetScale() const { return m_Scale; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+
+	private:
+		static constexpr float Smoothing{ 0.25f };
+
+		float m_TargetFrameTime{};
+		float m_MinScale{};
+		float m_MaxScale{};
+
+		float m_Scale{};
+		float m_AverageFullResolutionTime{ 0.f };
+	};
+}
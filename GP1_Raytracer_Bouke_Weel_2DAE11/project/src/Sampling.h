@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+
+#include "Maths.h"
+
+namespace dae
+{
+	namespace Sampling
+	{
+		//Small and fast PCG random generator, one per pixel sample so results don't depend on thread scheduling
+		class Random final
+		{
+		public:
+			explicit Random(uint32_t seed) : m_State(seed)
+			{
+				//the first outputs of neighbouring seeds are correlated
+				NextUInt();
+			}
+
+			uint32_t NextUInt()
+			{
+				m_State = m_State * 747796405u + 2891336453u;
+				const uint32_t word{ ((m_State >> ((m_State >> 28u) + 4u)) ^ m_State) * 277803737u };
+				return (word >> 22u) ^ word;
+			}
+
+			//[0, 1)
+			float Next()
+			{
+				return static_cast<float>(NextUInt() >> 8) * (1.f / 16777216.f);
+			}
+
+		private:
+			uint32_t m_State{};
+		};
+
+		/**
+		 * \brief Builds a world space direction from a direction in the frame around a normal
+		 * \param n Normal of the surface (z axis of the frame)
+		 * \param local Direction with z along the normal
+		 * \return World space direction
+		 */
+		inline Vector3 ToWorld(const Vector3& n, const Vector3& local)
+		{
+			//Duff et al. 2017, branchless orthonormal basis
+			const float sign{ std::copysign(1.f, n.z) };
+			const float a{ -1.f / (sign + n.z) };
+			const float b{ n.x * n.y * a };
+			const Vector3 tangent{ 1.f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+			const Vector3 bitangent{ b, sign + n.y * n.y * a, -n.y };
+
+			return tangent * local.x + bitangent * local.y + n * local.z;
+		}
+
+		/**
+		 * \param n Normal of the surface
+		 * \param u1 Uniform random number [0, 1)
+		 * \param u2 Uniform random number [0, 1)
+		 * \return Direction around n with a pdf of cos/PI
+		 */
+		inline Vector3 CosineHemisphere(const Vector3& n, float u1, float u2)
+		{
+			const float radius{ sqrtf(u1) };
+			const float phi{ PI_2 * u2 };
+			return ToWorld(n, { radius * cosf(phi), radius * sinf(phi), sqrtf(std::max(0.f, 1.f - u1)) });
+		}
+
+		inline float CosineHemispherePdf(const Vector3& n, const Vector3& l)
+		{
+			return std::max(0.f, Vector3::Dot(n, l)) / PI;
+		}
+
+		/**
+		 * \brief Samples a half vector proportional to D(h) * dot(n, h) of BRDF::NormalDistribution_GGX
+		 * \param n Normal of the surface
+		 * \param roughness Roughness of the material, squared like the BRDF (UE4)
+		 * \param u1 Uniform random number [0, 1)
+		 * \param u2 Uniform random number [0, 1)
+		 * \return Normalized half vector
+		 */
+		inline Vector3 GGXHalfVector(const Vector3& n, float roughness, float u1, float u2)
+		{
+			const float a2{ Square(Square(roughness)) };
+			const float cosTheta{ sqrtf((1.f - u1) / (1.f + (a2 - 1.f) * u1)) };
+			const float sinTheta{ sqrtf(std::max(0.f, 1.f - cosTheta * cosTheta)) };
+			const float phi{ PI_2 * u2 };
+			return ToWorld(n, { sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta });
+		}
+
+		/**
+		 * \brief Weight of one sampling technique when two techniques can produce the same sample (Veach, beta = 2)
+		 * \param pdf Pdf of the technique that made the sample
+		 * \param otherPdf Pdf of the other technique for the same sample
+		 * \return MIS weight
+		 */
+		inline float PowerHeuristic(float pdf, float otherPdf)
+		{
+			const float pdf2{ pdf * pdf };
+			const float sum{ pdf2 + otherPdf * otherPdf };
+			return sum > 0.f ? pdf2 / sum : 0.f;
+		}
+	}
+}
@@ -29,35 +29,123 @@ namespace dae {
 		m_Materials.clear();
 	}
 
+	void Scene::Update(dae::Timer* pTimer)
+	{
+		m_Camera.Update(pTimer);
+		Animate(pTimer->GetTotal());
+	}
+
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		for (auto sphere : m_SphereGeometries)
+		//objects are numbered spheres first, then planes, then meshes
+		int objectIndex{ 0 };
+		float closestT{ closestHit.t };
+
+		for (const Sphere& sphere : m_SphereGeometries)
 		{
 			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = objectIndex;
+				closestHit.primitiveIndex = 0;
+				closestT = closestHit.t;
+			}
+			++objectIndex;
 		}
-		for (auto plane : m_PlaneGeometries)
+		for (const Plane& plane : m_PlaneGeometries)
 		{
 			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = objectIndex;
+				closestHit.primitiveIndex = 0;
+				closestT = closestHit.t;
+			}
+			++objectIndex;
 		}
-		for (TriangleMesh triangleMesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
 		{
+			//the mesh test sets the triangle index itself
 			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = objectIndex;
+				closestT = closestHit.t;
+			}
+			++objectIndex;
+		}
+	}
+
+	void Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit, const ObjectCandidates& candidates) const
+	{
+		//same numbering and order as the full test, so both find the same hit
+		const int planeStart{ static_cast<int>(m_SphereGeometries.size()) };
+		const int meshStart{ planeStart + static_cast<int>(m_PlaneGeometries.size()) };
+		float closestT{ closestHit.t };
+
+		for (int sphereIndex : candidates.sphereIndices)
+		{
+			GeometryUtils::HitTest_Sphere(m_SphereGeometries[sphereIndex], ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = sphereIndex;
+				closestHit.primitiveIndex = 0;
+				closestT = closestHit.t;
+			}
+		}
+		for (int planeIndex = 0; planeIndex < static_cast<int>(m_PlaneGeometries.size()); ++planeIndex)
+		{
+			GeometryUtils::HitTest_Plane(m_PlaneGeometries[planeIndex], ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = planeStart + planeIndex;
+				closestHit.primitiveIndex = 0;
+				closestT = closestHit.t;
+			}
+		}
+		for (int meshIndex : candidates.meshIndices)
+		{
+			GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[meshIndex], ray, closestHit);
+			if (closestHit.t < closestT)
+			{
+				closestHit.objectIndex = meshStart + meshIndex;
+				closestT = closestHit.t;
+			}
+		}
+	}
+
+	void Scene::CullObjects(const Frustum& frustum, ObjectCandidates& candidates) const
+	{
+		candidates.sphereIndices.clear();
+		candidates.meshIndices.clear();
+
+		for (int sphereIndex = 0; sphereIndex < static_cast<int>(m_SphereGeometries.size()); ++sphereIndex)
+		{
+			const Sphere& sphere{ m_SphereGeometries[sphereIndex] };
+			if (frustum.IsSphereVisible(sphere.origin, sphere.radius))
+				candidates.sphereIndices.push_back(sphereIndex);
+		}
+		for (int meshIndex = 0; meshIndex < static_cast<int>(m_TriangleMeshGeometries.size()); ++meshIndex)
+		{
+			const TriangleMesh& triangleMesh{ m_TriangleMeshGeometries[meshIndex] };
+			if (frustum.IsAABBVisible(triangleMesh.transformedMinAABB, triangleMesh.transformedMaxAABB))
+				candidates.meshIndices.push_back(meshIndex);
 		}
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		for (auto sphere : m_SphereGeometries)
+		for (const Sphere& sphere : m_SphereGeometries)
 		{
 			if (GeometryUtils::HitTest_Sphere(sphere, ray))
 				return true;
 		}
-		for (auto plane : m_PlaneGeometries)
+		for (const Plane& plane : m_PlaneGeometries)
 		{
 			if(GeometryUtils::HitTest_Plane(plane, ray))
 				return true;
 		}
-		for (TriangleMesh triangleMesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
 		{
 			if(GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray))
 				return true;
@@ -66,6 +154,32 @@ namespace dae {
 		return false;
 	}
 
+	bool Scene::IsDirty() const
+	{
+		return m_Camera.isDirty || IsGeometryDirty();
+	}
+
+	bool Scene::IsGeometryDirty() const
+	{
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			if (triangleMesh.isDirty)
+				return true;
+		}
+
+		return false;
+	}
+
+	void Scene::ClearDirty()
+	{
+		m_Camera.isDirty = false;
+
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.isDirty = false;
+		}
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -123,6 +237,34 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
+	Light* Scene::AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.radius = radius;
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::Sphere;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
+	Light* Scene::AddQuadLight(const Vector3& origin, const Vector3& edge0, const Vector3& edge1, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.edge0 = edge0;
+		l.edge1 = edge1;
+		l.direction = Vector3::Cross(edge0, edge1).Normalized();
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::Quad;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
 	unsigned char Scene::AddMaterial(Material* pMaterial)
 	{
 		m_Materials.push_back(pMaterial);
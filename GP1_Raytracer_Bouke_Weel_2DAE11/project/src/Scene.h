@@ -15,6 +15,13 @@ namespace dae
 	struct Sphere;
 	struct Light;
 
+	//Objects a group of rays can hit, planes are unbounded and always tested
+	struct ObjectCandidates
+	{
+		std::vector<int> sphereIndices{};
+		std::vector<int> meshIndices{};
+	};
+
 	//Scene Base Class
 	class Scene
 	{
@@ -28,19 +35,29 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
-		virtual void Update(dae::Timer* pTimer)
-		{
-			m_Camera.Update(pTimer);
-		}
+		void Update(dae::Timer* pTimer);
+
+		//Time driven scene animation, kept separate from the camera so the render thread can evaluate it
+		virtual void Animate(float /*totalTime*/) {}
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		//only tests the candidates, the hit is the same as the full test for rays inside the frustum they were culled with
+		void GetClosestHit(const Ray& ray, HitRecord& closestHit, const ObjectCandidates& candidates) const;
+		//spheres and mesh bounds inside the frustum
+		void CullObjects(const Frustum& frustum, ObjectCandidates& candidates) const;
 		bool DoesHit(const Ray& ray) const;
 
+		//Dirty tracking (camera + mesh transforms), used to skip rendering unchanged frames
+		bool IsDirty() const;
+		//only mesh transforms, cached shading stays valid while just the camera moves
+		bool IsGeometryDirty() const;
+		void ClearDirty();
+
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
@@ -62,6 +79,9 @@ namespace dae
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+		Light* AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color);
+		//edges span the whole quad around origin, light leaves on the side of Cross(edge0, edge1)
+		Light* AddQuadLight(const Vector3& origin, const Vector3& edge0, const Vector3& edge1, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
 	};
 
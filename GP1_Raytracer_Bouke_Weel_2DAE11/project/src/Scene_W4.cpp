@@ -65,11 +65,9 @@ void dae::Scene_W4::Initialize()
 }
 
 
-void dae::Scene_W4::Update(dae::Timer* pTimer)
+void dae::Scene_W4::Animate(float totalTime)
 {
-	Scene::Update(pTimer);
-
-	pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
+	pMesh->RotateY(PI_DIV_2 * totalTime);
 	pMesh->UpdateTransforms();
 }
 
@@ -134,11 +132,9 @@ void dae::Scene_W4_ReferenceScene::Initialize()
 	AddPointLight(Vector3{ 2.5f,2.5f,-5.f }, 50.f, ColorRGB{ .34f,.47f,.68f }); //fill Light
 }
 
-void dae::Scene_W4_ReferenceScene::Update(dae::Timer* pTimer)
+void dae::Scene_W4_ReferenceScene::Animate(float totalTime)
 {
-	Scene::Update(pTimer);
-
-	const auto yawAngle{ (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
+	const auto yawAngle{ (cos(totalTime) + 1.f) / 2.f * PI_2 };
 	for (auto mesh : m_pMeshes)
 	{
 		mesh->RotateY(yawAngle);
@@ -174,7 +170,7 @@ void dae::Scene_W4_Bunny::Initialize()
 	pMesh->RotateY(PI);
 
 	pMesh->UpdateAABB();
-	pMesh->UpdateTransforms();
+	pMesh->BuildBVH();
 
 	//lights
 	AddPointLight(Vector3{ 0.f,5.f,5.f }, 50.f, ColorRGB{ 1.f,.61f,.45f }); //BackLight
@@ -182,15 +178,49 @@ void dae::Scene_W4_Bunny::Initialize()
 	AddPointLight(Vector3{ 2.5f,2.5f,-5.f }, 50.f, ColorRGB{ .34f,.47f,.68f }); //fill Light
 }
 
-void dae::Scene_W4_Bunny::Update(dae::Timer* pTimer)
+void dae::Scene_W4_Bunny::Animate(float totalTime)
 {
-	Scene::Update(pTimer);
-
-	const auto yawAngle{ (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
+	const auto yawAngle{ (cos(totalTime) + 1.f) / 2.f * PI_2 };
 
 	pMesh->RotateY(yawAngle);
 	pMesh->UpdateTransforms();
 	
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
+
+#pragma region ReflectionScene
+void dae::Scene_W4_ReflectionScene::Initialize()
+{
+	sceneName = "Reflection Scene";
+	m_Camera.origin = { 0.f,3.f,-9.f };
+	m_Camera.fovAngle = 45.f;
+
+	const auto matMirror = AddMaterial(new Material_Mirror({ .95f,.95f,.95f }));
+	const auto matGlass = AddMaterial(new Material_Dielectric(1.5f));
+	const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, 0.f, .1f));
+	const auto matCT_GoldMetal = AddMaterial(new Material_CookTorrence({ 1.f,.782f,.344f }, 1.f, .3f));
+
+	const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,0.57f,0.57f }, 1.f));
+	const auto matLambert_Red = AddMaterial(new Material_Lambert({ .7f,.15f,.1f }, 1.f));
+	const auto matLambert_Green = AddMaterial(new Material_Lambert({ .15f,.6f,.15f }, 1.f));
+
+	//planes
+	AddPlane(Vector3{ 0.f,0.f,10.f }, Vector3{ 0.f,0.f,-1.f }, matMirror); //back
+	AddPlane(Vector3{ 0.f,0.f,0.f }, Vector3{ 0.f,1.f,0.f }, matLambert_GrayBlue);   //bottom
+	AddPlane(Vector3{ 0.f,10.f,0.f }, Vector3{ 0.f,-1.f,0.f }, matLambert_GrayBlue); //top
+	AddPlane(Vector3{ 5.f,0.f,0.f }, Vector3{ -1.f,0.f,0.f }, matLambert_Green);  //right
+	AddPlane(Vector3{ -5.f,0.f,0.f }, Vector3{ 1.f,0.f,0.f }, matLambert_Red);  // left
+
+	//spheres
+	AddSphere(Vector3{ -1.75f,1.f,0.f }, .75, matMirror);
+	AddSphere(Vector3{ 0.f,1.f,-1.f }, .75, matGlass);
+	AddSphere(Vector3{ 1.75f,1.f,0.f }, .75, matCT_GoldMetal);
+	AddSphere(Vector3{ 0.f,3.f,1.f }, .75, matCT_GraySmoothPlastic);
+
+	//lights
+	AddQuadLight(Vector3{ 0.f,9.9f,2.f }, Vector3{ 2.f,0.f,0.f }, Vector3{ 0.f,0.f,2.f }, 250.f, ColorRGB{ 1.f,.61f,.45f }); //ceiling Light
+	AddSphereLight(Vector3{ -2.5f,5.f,-5.f }, .5f, 70.f, ColorRGB{ 1.f,.8f,.45f }); //Front light
+	AddPointLight(Vector3{ 2.5f,2.5f,-5.f }, 50.f, ColorRGB{ .34f,.47f,.68f }); //fill Light
+}
+#pragma endregion
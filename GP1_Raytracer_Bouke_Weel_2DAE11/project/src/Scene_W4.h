@@ -15,7 +15,7 @@ namespace dae
 		Scene_W4& operator=(Scene_W4&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(dae::Timer* pTimer) override;
+		void Animate(float totalTime) override;
 	private:
 		TriangleMesh* pMesh{ nullptr };
 	};
@@ -32,7 +32,7 @@ namespace dae
 		Scene_W4_ReferenceScene& operator=(Scene_W4_ReferenceScene&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(dae::Timer* pTimer) override;
+		void Animate(float totalTime) override;
 	private:
 		TriangleMesh* m_pMeshes[3]{};
 	};
@@ -49,9 +49,23 @@ namespace dae
 		Scene_W4_Bunny& operator=(Scene_W4_Bunny&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(dae::Timer* pTimer) override;
+		void Animate(float totalTime) override;
 	private:
 		TriangleMesh* pMesh{};
 	};
 
+	class Scene_W4_ReflectionScene final : public Scene
+	{
+	public:
+		Scene_W4_ReflectionScene() = default;
+		~Scene_W4_ReflectionScene() override = default;
+
+		Scene_W4_ReflectionScene(const Scene_W4_ReflectionScene&) = delete;
+		Scene_W4_ReflectionScene(Scene_W4_ReflectionScene&&) noexcept = delete;
+		Scene_W4_ReflectionScene& operator=(const Scene_W4_ReflectionScene&) = delete;
+		Scene_W4_ReflectionScene& operator=(Scene_W4_ReflectionScene&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
 }
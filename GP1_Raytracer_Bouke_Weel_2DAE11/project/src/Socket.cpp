@@ -0,0 +1,271 @@
+#include "Socket.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+#ifdef _WIN32
+	using NativeSocket = SOCKET;
+
+	//winsock has to be started once before the first socket call
+	void StartSockets()
+	{
+		static const bool isStarted{ []()
+			{
+				WSADATA data{};
+				return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+			}() };
+
+		if (!isStarted)
+			std::cout << "Winsock failed to start" << std::endl;
+	}
+
+	void CloseNative(NativeSocket handle) { closesocket(handle); }
+#else
+	using NativeSocket = int;
+
+	void StartSockets() {}
+	void CloseNative(NativeSocket handle) { close(handle); }
+#endif
+
+	NativeSocket ToNative(intptr_t handle)
+	{
+		return static_cast<NativeSocket>(handle);
+	}
+
+	void ConfigureConnection(NativeSocket handle)
+	{
+		//tiles are sent as one big write, Nagle would only delay the small job messages
+		int noDelay{ 1 };
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+#ifdef SO_NOSIGPIPE
+		//platforms without MSG_NOSIGNAL
+		int noSigPipe{ 1 };
+		setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+	}
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket::Socket(Socket&& other) noexcept :
+	m_Handle(other.m_Handle)
+{
+	other.m_Handle = InvalidHandle;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_Handle = other.m_Handle;
+		other.m_Handle = InvalidHandle;
+	}
+	return *this;
+}
+
+Socket Socket::Listen(uint16_t port)
+{
+	StartSockets();
+
+	const NativeSocket handle{ socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) };
+	Socket listener{ static_cast<intptr_t>(handle) };
+	if (!listener.IsValid())
+		return {};
+
+	//a farm restarted right after the last one can take the same port again
+	int reuse{ 1 };
+	setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, SOMAXCONN) != 0)
+		return {};
+
+	return listener;
+}
+
+Socket Socket::Connect(const std::string& host, uint16_t port)
+{
+	StartSockets();
+
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* pAddresses{};
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pAddresses) != 0)
+		return {};
+
+	Socket connection{};
+	for (const addrinfo* pAddress = pAddresses; pAddress && !connection.IsValid(); pAddress = pAddress->ai_next)
+	{
+		Socket attempt{ static_cast<intptr_t>(socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol)) };
+		if (attempt.IsValid() && connect(ToNative(attempt.m_Handle), pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0)
+			connection = std::move(attempt);
+	}
+	freeaddrinfo(pAddresses);
+
+	if (connection.IsValid())
+		ConfigureConnection(ToNative(connection.m_Handle));
+
+	return connection;
+}
+
+Socket Socket::Accept(int timeoutMs) const
+{
+	if (!WaitReadable({ this }, timeoutMs)[0])
+		return {};
+
+	Socket connection{ static_cast<intptr_t>(accept(ToNative(m_Handle), nullptr, nullptr)) };
+	if (connection.IsValid())
+		ConfigureConnection(ToNative(connection.m_Handle));
+
+	return connection;
+}
+
+bool Socket::SendAll(const void* pData, size_t size) const
+{
+	const char* pBytes{ static_cast<const char*>(pData) };
+	while (size > 0)
+	{
+		//no SIGPIPE when the other side is gone, the failed send is enough
+#if defined(_WIN32)
+		const int sent{ send(ToNative(m_Handle), pBytes, static_cast<int>(std::min<size_t>(size, INT32_MAX)), 0) };
+#elif defined(MSG_NOSIGNAL)
+		const ssize_t sent{ send(ToNative(m_Handle), pBytes, size, MSG_NOSIGNAL) };
+#else
+		const ssize_t sent{ send(ToNative(m_Handle), pBytes, size, 0) };
+#endif
+		if (sent <= 0)
+			return false;
+
+		pBytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool Socket::ReceiveAll(void* pData, size_t size) const
+{
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+#ifdef _WIN32
+		const int received{ recv(ToNative(m_Handle), pBytes, static_cast<int>(std::min<size_t>(size, INT32_MAX)), 0) };
+#else
+		const ssize_t received{ recv(ToNative(m_Handle), pBytes, size, 0) };
+#endif
+		//0 is a closed connection, negative an error or a timeout
+		if (received <= 0)
+			return false;
+
+		pBytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+int Socket::Receive(void* pData, size_t size) const
+{
+	const int maxSize{ static_cast<int>(std::min<size_t>(size, INT32_MAX)) };
+#ifdef _WIN32
+	return recv(ToNative(m_Handle), static_cast<char*>(pData), maxSize, 0);
+#else
+	return static_cast<int>(recv(ToNative(m_Handle), pData, static_cast<size_t>(maxSize), 0));
+#endif
+}
+
+void Socket::SetReceiveTimeout(int timeoutMs) const
+{
+#ifdef _WIN32
+	const DWORD timeout{ static_cast<DWORD>(timeoutMs) };
+#else
+	const timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+#endif
+	setsockopt(ToNative(m_Handle), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+std::vector<bool> Socket::WaitReadable(const std::vector<const Socket*>& sockets, int timeoutMs)
+{
+	std::vector<bool> isReadable(sockets.size(), false);
+
+	fd_set readSet{};
+	FD_ZERO(&readSet);
+	NativeSocket highestHandle{};
+	for (const Socket* pSocket : sockets)
+	{
+		if (!pSocket->IsValid())
+			continue;
+
+		FD_SET(ToNative(pSocket->m_Handle), &readSet);
+		highestHandle = std::max(highestHandle, ToNative(pSocket->m_Handle));
+	}
+
+	//the first argument is ignored by winsock
+	timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+	if (select(static_cast<int>(highestHandle) + 1, &readSet, nullptr, nullptr, &timeout) <= 0)
+		return isReadable;
+
+	for (size_t i = 0; i < sockets.size(); ++i)
+	{
+		isReadable[i] = sockets[i]->IsValid() && FD_ISSET(ToNative(sockets[i]->m_Handle), &readSet);
+	}
+	return isReadable;
+}
+
+bool Socket::IsValid() const
+{
+	return m_Handle != InvalidHandle;
+}
+
+uint16_t Socket::GetPort() const
+{
+	sockaddr_in address{};
+#ifdef _WIN32
+	int length{ sizeof(address) };
+#else
+	socklen_t length{ sizeof(address) };
+#endif
+	if (getsockname(ToNative(m_Handle), reinterpret_cast<sockaddr*>(&address), &length) != 0)
+		return 0;
+
+	return ntohs(address.sin_port);
+}
+
+void Socket::Close()
+{
+	if (!IsValid())
+		return;
+
+	CloseNative(ToNative(m_Handle));
+	m_Handle = InvalidHandle;
+}
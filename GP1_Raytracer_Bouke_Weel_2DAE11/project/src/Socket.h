@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//Blocking TCP socket, winsock on Windows and BSD sockets everywhere else.
+	//Owns the handle, so it can be moved but not copied.
+	class Socket final
+	{
+	public:
+		Socket() = default;
+		~Socket();
+
+		Socket(const Socket&) = delete;
+		Socket(Socket&& other) noexcept;
+		Socket& operator=(const Socket&) = delete;
+		Socket& operator=(Socket&& other) noexcept;
+
+		//Listens on the loopback interface, port 0 lets the system pick a free port
+		static Socket Listen(uint16_t port);
+		static Socket Connect(const std::string& host, uint16_t port);
+
+		//invalid socket when nobody connected within the timeout
+		Socket Accept(int timeoutMs) const;
+
+		//false when the connection is closed or broken, the socket should be dropped afterwards
+		bool SendAll(const void* pData, size_t size) const;
+		bool ReceiveAll(void* pData, size_t size) const;
+		//Takes what already arrived, up to size bytes, after WaitReadable marked the socket this doesn't block
+		//returns the byte count, 0 when the connection is closed and negative on errors
+		int Receive(void* pData, size_t size) const;
+
+		//a blocked receive gives up after this long, 0 waits forever
+		void SetReceiveTimeout(int timeoutMs) const;
+
+		//Waits until at least one socket has data (or was closed) and marks which ones
+		static std::vector<bool> WaitReadable(const std::vector<const Socket*>& sockets, int timeoutMs);
+
+		bool IsValid() const;
+		uint16_t GetPort() const;
+		void Close();
+
+	private:
+		//SOCKET on Windows is pointer sized, int file descriptors fit as well
+		explicit Socket(intptr_t handle) : m_Handle(handle) {}
+
+		static constexpr intptr_t InvalidHandle{ -1 };
+		intptr_t m_Handle{ InvalidHandle };
+	};
+}
@@ -0,0 +1,135 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+TileScheduler::TileScheduler(const std::vector<FarmTile>& tiles) :
+	m_Tiles(tiles),
+	m_IsFinished(tiles.size(), false),
+	m_Copies(tiles.size(), 0)
+{
+	for (int tile = 0; tile < static_cast<int>(tiles.size()); ++tile)
+	{
+		m_Pending.push_back(tile);
+	}
+}
+
+int TileScheduler::Assign(int worker, double time)
+{
+	if (worker >= static_cast<int>(m_Assignments.size()))
+		m_Assignments.resize(worker + 1);
+
+	Assignment& assignment{ m_Assignments[worker] };
+	if (assignment.tile >= 0)
+		return -1;
+
+	//a failed tile can still be queued after a copy of it finished
+	while (!m_Pending.empty() && m_IsFinished[m_Pending.front()])
+	{
+		m_Pending.pop_front();
+	}
+
+	int tile{ -1 };
+	if (!m_Pending.empty())
+	{
+		tile = m_Pending.front();
+		m_Pending.pop_front();
+	}
+	else
+	{
+		tile = FindStraggler(worker, time);
+	}
+
+	if (tile >= 0)
+	{
+		assignment = { tile, time };
+		++m_Copies[tile];
+	}
+	return tile;
+}
+
+bool TileScheduler::Complete(int worker, double time)
+{
+	Assignment& assignment{ m_Assignments[worker] };
+	const int tile{ assignment.tile };
+	--m_Copies[tile];
+	assignment.tile = -1;
+
+	if (m_IsFinished[tile])
+		return false;
+
+	m_IsFinished[tile] = true;
+	++m_FinishedTiles;
+	m_TotalTileTime += time - assignment.startTime;
+	return true;
+}
+
+void TileScheduler::Fail(int worker)
+{
+	if (worker >= static_cast<int>(m_Assignments.size()))
+		return;
+
+	Assignment& assignment{ m_Assignments[worker] };
+	const int tile{ assignment.tile };
+	if (tile < 0)
+		return;
+
+	--m_Copies[tile];
+	assignment.tile = -1;
+
+	//no need to wait for a straggler copy when nobody else is on it
+	if (!m_IsFinished[tile] && m_Copies[tile] == 0)
+		m_Pending.push_front(tile);
+}
+
+std::vector<int> TileScheduler::GetHungWorkers(double time) const
+{
+	const double hungTime{ std::max(MinHungTime, GetAverageTileTime() * HungFactor) };
+
+	std::vector<int> hungWorkers{};
+	for (int worker = 0; worker < static_cast<int>(m_Assignments.size()); ++worker)
+	{
+		const Assignment& assignment{ m_Assignments[worker] };
+		if (assignment.tile >= 0 && time - assignment.startTime > hungTime)
+			hungWorkers.push_back(worker);
+	}
+	return hungWorkers;
+}
+
+int TileScheduler::GetAssignedTile(int worker) const
+{
+	return worker < static_cast<int>(m_Assignments.size()) ? m_Assignments[worker].tile : -1;
+}
+
+double TileScheduler::GetAverageTileTime() const
+{
+	return m_FinishedTiles > 0 ? m_TotalTileTime / m_FinishedTiles : 0.0;
+}
+
+int TileScheduler::FindStraggler(int worker, double time) const
+{
+	//without finished tiles there is nothing to compare against
+	if (m_FinishedTiles == 0)
+		return -1;
+
+	const double stragglerTime{ GetAverageTileTime() * StragglerFactor };
+
+	//the tile that has been running the longest
+	int straggler{ -1 };
+	double longestTime{ stragglerTime };
+	for (int other = 0; other < static_cast<int>(m_Assignments.size()); ++other)
+	{
+		const Assignment& assignment{ m_Assignments[other] };
+		if (other == worker || assignment.tile < 0 || m_Copies[assignment.tile] >= MaxCopies || m_IsFinished[assignment.tile])
+			continue;
+
+		const double runningTime{ time - assignment.startTime };
+		if (runningTime > longestTime)
+		{
+			straggler = assignment.tile;
+			longestTime = runningTime;
+		}
+	}
+	return straggler;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <deque>
+#include <vector>
+
+namespace dae
+{
+	struct FarmTile
+	{
+		int frame{};
+		int x{};
+		int y{};
+		int width{};
+		int height{};
+	};
+
+	//Decides which render farm worker traces which tile. Workers hold one tile at a time; tiles of a failed worker
+	//go back to the front of the queue, and once the queue is empty idle workers get copies of tiles that take far
+	//longer than usual so a slow worker can't hold up the frame. The first finished copy wins.
+	//Times are in seconds on any monotonic clock.
+	class TileScheduler final
+	{
+	public:
+		TileScheduler(const std::vector<FarmTile>& tiles);
+		~TileScheduler() = default;
+
+		TileScheduler(const TileScheduler&) = delete;
+		TileScheduler(TileScheduler&&) noexcept = delete;
+		TileScheduler& operator=(const TileScheduler&) = delete;
+		TileScheduler& operator=(TileScheduler&&) noexcept = delete;
+
+		//tile index for an idle worker, -1 when there is nothing to hand out right now
+		int Assign(int worker, double time);
+		//the worker returned its tile, false when another copy of the tile finished first
+		bool Complete(int worker, double time);
+		//the worker is gone, its tile has to be traced by someone else
+		void Fail(int worker);
+
+		//workers that have been on their tile for so long that they are most likely hung
+		std::vector<int> GetHungWorkers(double time) const;
+
+		int GetAssignedTile(int worker) const;
+		const FarmTile& GetTile(int tile) const { return m_Tiles[tile]; }
+		bool IsFinished() const { return m_FinishedTiles == static_cast<int>(m_Tiles.size()); }
+
+		//a copy is handed out once a tile runs this many times longer than the average tile
+		static constexpr double StragglerFactor{ 3.0 };
+		static constexpr int MaxCopies{ 2 };
+		//a worker is given up on after this many average tile times, but never before MinHungTime
+		static constexpr double HungFactor{ 20.0 };
+		static constexpr double MinHungTime{ 10.0 };
+
+	private:
+		struct Assignment
+		{
+			int tile{ -1 };
+			double startTime{};
+		};
+
+		double GetAverageTileTime() const;
+		int FindStraggler(int worker, double time) const;
+
+		std::vector<FarmTile> m_Tiles{};
+		std::vector<bool> m_IsFinished{};
+		std::vector<int> m_Copies{};		//workers tracing each tile right now
+		std::deque<int> m_Pending{};
+		std::vector<Assignment> m_Assignments{};	//indexed by worker
+
+		int m_FinishedTiles{ 0 };
+		double m_TotalTileTime{ 0.0 };
+	};
+}
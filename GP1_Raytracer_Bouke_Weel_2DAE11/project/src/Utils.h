@@ -2,6 +2,7 @@
 #include <fstream>
 #include "Maths.h"
 #include "DataTypes.h"
+#include "Sampling.h"
 
 namespace dae
 {
@@ -194,11 +195,68 @@ namespace dae
 			return tmax > 0 && tmax >= tmin;
 		}
 
+		//The ray goes to object space instead of the mesh to world, the direction isn't normalized so t stays the same
+		inline bool HitTest_TriangleMeshBVH(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+		{
+			const Ray objectRay{ mesh.inverseTransform.TransformPoint(ray.origin), mesh.inverseTransform.TransformVector(ray.direction), ray.min, ray.max };
+
+			Triangle triangle;
+			triangle.materialIndex = mesh.materialIndex;
+			triangle.cullMode = mesh.cullMode;
+
+			HitRecord objectHit{};
+			objectHit.t = hitRecord.t;
+			int hitTriangle{ -1 };
+			bool didHit{ false };
+
+			mesh.bvh.Traverse(objectRay.origin, objectRay.direction, ray.min, std::min(ray.max, hitRecord.t),
+				[&](int firstTriangle, int triangleCount, float& tMax)
+				{
+					for (int currentTriangle = firstTriangle; currentTriangle < firstTriangle + triangleCount; ++currentTriangle)
+					{
+						triangle.v0 = mesh.positions[mesh.indices[currentTriangle * 3]];
+						triangle.v1 = mesh.positions[mesh.indices[currentTriangle * 3 + 1]];
+						triangle.v2 = mesh.positions[mesh.indices[currentTriangle * 3 + 2]];
+						triangle.normal = mesh.normals[currentTriangle];
+
+						if (!HitTest_Triangle(triangle, objectRay, objectHit, ignoreHitRecord))
+							continue;
+
+						//shadow rays stop at anything in the way
+						didHit = true;
+						if (ignoreHitRecord)
+							return true;
+
+						if (objectHit.t < tMax)
+						{
+							tMax = objectHit.t;
+							hitTriangle = currentTriangle;
+						}
+					}
+					return false;
+				});
+
+			if (hitTriangle >= 0)
+			{
+				hitRecord.t = objectHit.t;
+				hitRecord.origin = ray.origin + ray.direction * objectHit.t;
+				hitRecord.normal = mesh.transform.TransformVector(mesh.normals[hitTriangle]);
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = mesh.materialIndex;
+				hitRecord.primitiveIndex = hitTriangle;
+			}
+			return didHit;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			if (!SlabTest_triangleMesh(mesh, ray))
 				return false;
 
+			if (!mesh.bvh.IsEmpty())
+				return HitTest_TriangleMeshBVH(mesh, ray, hitRecord, ignoreHitRecord);
+
+			bool didHit{ false };
 			int currentTriangle{0};
 			for (size_t i = 0; i < mesh.indices.size(); i += 3, currentTriangle++)
 			{
@@ -212,10 +270,19 @@ namespace dae
 				triangle.cullMode = mesh.cullMode;
 
 				//use the HitTest_Traingle cuz I am lazy
+				const float closestT{ hitRecord.t };
 				if (HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord))
-					return true;
+				{
+					//shadow rays stop at anything in the way, the others keep looking for a closer triangle
+					if (ignoreHitRecord)
+						return true;
+
+					if (hitRecord.t < closestT)
+						hitRecord.primitiveIndex = currentTriangle;
+					didHit = true;
+				}
 			}
-			return false;
+			return didHit;
 		}
 
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
@@ -251,6 +318,110 @@ namespace dae
 
 			return {};
 		}
+
+		inline bool IsAreaLight(const Light& light)
+		{
+			return light.type == LightType::Sphere || light.type == LightType::Quad;
+		}
+
+		//Point on the light that lights the target, area lights pick it uniformly over their surface with u1, u2 [0,1)
+		inline Vector3 SampleLightPoint(const Light& light, const Vector3& target, float u1, float u2)
+		{
+			if (light.type == LightType::Sphere)
+			{
+				//the disk of the sphere facing the target, it covers the same solid angle for distant targets
+				const float radius{ light.radius * sqrtf(u1) };
+				const float phi{ PI_2 * u2 };
+				return light.origin + Sampling::ToWorld((target - light.origin).Normalized(), { radius * cosf(phi), radius * sinf(phi), 0.f });
+			}
+
+			if (light.type == LightType::Quad)
+			{
+				return light.origin + light.edge0 * (u1 - 0.5f) + light.edge1 * (u2 - 0.5f);
+			}
+
+			return light.origin;
+		}
+
+		//Radiance arriving at the target from one point of the light, area lights spread their intensity over the surface
+		inline ColorRGB GetRadiance(const Light& light, const Vector3& lightPoint, const Vector3& target)
+		{
+			if (light.type == LightType::Sphere)
+			{
+				return light.color * (light.intensity / (lightPoint - target).SqrMagnitude());
+			}
+
+			if (light.type == LightType::Quad)
+			{
+				const Vector3 toTarget{ target - lightPoint };
+				const float distanceSqr{ toTarget.SqrMagnitude() };
+				const float cosine{ Vector3::Dot(light.direction, toTarget) / sqrtf(distanceSqr) };
+				return light.color * (std::max(0.f, cosine) * light.intensity / distanceSqr);
+			}
+
+			return GetRadiance(light, target);
+		}
+
+		inline float GetArea(const Light& light)
+		{
+			if (light.type == LightType::Sphere)
+				return PI * Square(light.radius);
+
+			if (light.type == LightType::Quad)
+				return Vector3::Cross(light.edge0, light.edge1).Magnitude();
+
+			return 0.f;
+		}
+
+		//Radiance leaving an area light, its intensity spread over the surface
+		inline ColorRGB GetEmittedRadiance(const Light& light)
+		{
+			return light.color * (light.intensity / GetArea(light));
+		}
+
+		//Solid angle pdf of SampleLightPoint as seen from the target
+		inline float GetLightPdf(const Light& light, const Vector3& lightPoint, const Vector3& target)
+		{
+			const Vector3 toTarget{ target - lightPoint };
+			const float distanceSqr{ toTarget.SqrMagnitude() };
+			const float cosine{ light.type == LightType::Quad ? Vector3::Dot(light.direction, toTarget) / sqrtf(distanceSqr) : 1.f };
+			if (cosine <= 0.f)
+				return 0.f;
+
+			return distanceSqr / (cosine * GetArea(light));
+		}
+
+		//Rays that hit an area light, used to weigh BRDF samples against light samples. Quads have to be rectangles
+		inline bool HitTest_Light(const Light& light, const Ray& ray, float& t)
+		{
+			if (light.type == LightType::Sphere)
+			{
+				Sphere sphere{ light.origin, light.radius };
+				HitRecord hitRecord{};
+				if (!GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord))
+					return false;
+				t = hitRecord.t;
+				return true;
+			}
+
+			if (light.type == LightType::Quad)
+			{
+				const float directionDotNormal{ Vector3::Dot(ray.direction, light.direction) };
+				//only the emitting side
+				if (directionDotNormal >= 0.f)
+					return false;
+
+				t = Vector3::Dot(light.origin - ray.origin, light.direction) / directionDotNormal;
+				if (t < ray.min || t > ray.max)
+					return false;
+
+				const Vector3 local{ ray.origin + ray.direction * t - light.origin };
+				return std::abs(Vector3::Dot(local, light.edge0)) <= 0.5f * light.edge0.SqrMagnitude()
+					&& std::abs(Vector3::Dot(local, light.edge1)) <= 0.5f * light.edge1.SqrMagnitude();
+			}
+
+			return false;
+		}
 	}
 
 	namespace Utils
@@ -7,11 +7,19 @@
 #undef main
 
 //Standard includes
+#include <charconv>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 //Project includes
 #include "Timer.h"
+#include "BatchRenderer.h"
+#include "ImageWriter.h"
+#include "RenderFarm.h"
 #include "Renderer.h"
+#include "RenderThread.h"
 #include "Scene.h"
 #include "Scene_W2.h"
 #include "Scene_W3.h"
@@ -27,11 +35,95 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+//false unless the whole argument is a number
+template<typename T>
+bool ParseArgument(const char* argument, T& value)
+{
+	const char* pEnd{ argument + std::char_traits<char>::length(argument) };
+	const auto [pLast, error] { std::from_chars(argument, pEnd, value) };
+	return error == std::errc{} && pLast == pEnd;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage:\n"
+		<< "  --batch <frameCount> [framesPerSecond] [samplesPerPixel]\n"
+		<< "  --farm <frameCount> <workerCount> [framesPerSecond] [samplesPerPixel]\n"
+		<< "  --worker <port> [host]\n"
+		<< "    counts and framesPerSecond are positive, samplesPerPixel is 0 (direct lighting) or more, port is 1 to 65535" << std::endl;
+}
+
+Scene* CreateScene()
+{
+	//const auto pScene = new Scene_W1();
+	//const auto pScene = new Scene_W2();
+	//const auto pScene = new Scene_W3();
+	//const auto pScene = new Scene_W4();
+
+#ifdef ReflectionScene
+	return new Scene_W4_ReflectionScene();
+#elif defined(BunnyScene)
+	return new Scene_W4_Bunny();
+#elif defined(RefrenceScene)
+	return new Scene_W4_ReferenceScene();
+#endif
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Offline animation: --batch <frameCount> [framesPerSecond] [samplesPerPixel]
+	if (argc > 2 && std::string(args[1]) == "--batch")
+	{
+		BatchSettings settings{};
+		if (!ParseArgument(args[2], settings.frameCount) || settings.frameCount <= 0
+			|| (argc > 3 && (!ParseArgument(args[3], settings.framesPerSecond) || settings.framesPerSecond <= 0.f))
+			|| (argc > 4 && (!ParseArgument(args[4], settings.samplesPerPixel) || settings.samplesPerPixel < 0)))
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		SDL_Init(0);
+		BatchRenderer batchRenderer{ CreateScene, settings };
+		const bool isFinished{ batchRenderer.Run() };
+		SDL_Quit();
+		return isFinished ? 0 : 1;
+	}
+
+	//Render farm coordinator, starts the workers itself: --farm <frameCount> <workerCount> [framesPerSecond] [samplesPerPixel]
+	if (argc > 3 && std::string(args[1]) == "--farm")
+	{
+		RenderFarmSettings settings{};
+		if (!ParseArgument(args[2], settings.batch.frameCount) || settings.batch.frameCount <= 0
+			|| !ParseArgument(args[3], settings.workerCount) || settings.workerCount <= 0
+			|| (argc > 4 && (!ParseArgument(args[4], settings.batch.framesPerSecond) || settings.batch.framesPerSecond <= 0.f))
+			|| (argc > 5 && (!ParseArgument(args[5], settings.batch.samplesPerPixel) || settings.batch.samplesPerPixel < 0)))
+		{
+			PrintUsage();
+			return 1;
+		}
+		settings.workerExecutable = args[0];
+
+		RenderFarm renderFarm{ settings };
+		return renderFarm.Run() ? 0 : 1;
+	}
+
+	//Render farm worker: --worker <port> [host]
+	if (argc > 2 && std::string(args[1]) == "--worker")
+	{
+		//parsed as an int first so ports out of range are rejected instead of wrapped
+		int port{};
+		if (!ParseArgument(args[2], port) || port <= 0 || port > UINT16_MAX)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		SDL_Init(0);
+		RenderFarm::RunWorker(CreateScene, argc > 3 ? args[3] : "127.0.0.1", static_cast<uint16_t>(port));
+		SDL_Quit();
+		return 0;
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -52,18 +144,15 @@ int main(int argc, char* args[])
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
 
-	//const auto pScene = new Scene_W1();
-	//const auto pScene = new Scene_W2();
-	//const auto pScene = new Scene_W3();
-	//const auto pScene = new Scene_W4();
+	const auto pScene = CreateScene();
+	pScene->Initialize();
 
-#ifdef BunnyScene
-	const auto pScene = new Scene_W4_Bunny();
-#elif defined(RefrenceScene)
-	const auto pScene = new Scene_W4_ReferenceScene();
-#endif
+	//Rendering runs on its own thread, this thread polls input, updates the camera and presents
+	Camera inputCamera{ pScene->GetCamera() };
+	const auto pRenderThread = new RenderThread(pRenderer, pScene);
 
-	pScene->Initialize();
+	//Screenshots and frame dumps are encoded on their own thread
+	const auto pImageWriter = new ImageWriter();
 
 	//Start loop
 	pTimer->Start();
@@ -71,11 +160,18 @@ int main(int argc, char* args[])
 	// Start Benchmark
 	// pTimer->StartBenchmark();
 
-	float printTimer = 0.f;
+	//input is sampled at a fixed rate, independent of how long a frame takes
+	constexpr uint64_t inputIntervalMs = 4;
+
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool takeHdrScreenshot = false;
+	bool isRecording = false;
+	int recordedFrame = 0;
 	while (isLooping)
 	{
+		const uint64_t tickStart = SDL_GetTicks64();
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -88,45 +184,85 @@ int main(int argc, char* args[])
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_H)
+					takeHdrScreenshot = true;
 				break;
 			case SDL_KEYDOWN:
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->ToggleShadows();
+					pRenderThread->QueueToggleShadows();
 
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
-					pRenderer->CycleLightingMode();
+					pRenderThread->QueueCycleLightingMode();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderThread->QueueToggleDynamicResolution();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					pRenderThread->QueueToggleDenoiser();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					pRenderThread->QueueToggleReprojection();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderThread->QueueToggleAdaptiveSampling();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderThread->QueueTogglePathTracing();
+
+				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+				{
+					isRecording = !isRecording;
+					std::cout << (isRecording ? "Recording frames\n" : "Stopped recording\n");
+				}
 
 				break;
 			}
 		}
 
+		//--------- Timer ---------
+		pTimer->Update();
+
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		inputCamera.Update(pTimer);
+		pRenderThread->Submit(inputCamera, pTimer->GetTotal());
+		inputCamera.isDirty = false;
 
-		//--------- Render ---------
-		pRenderer->Render(pScene);
+		//--------- Present ---------
+		const bool presentedFrame = pRenderer->Present();
 
-		//--------- Timer ---------
-		pTimer->Update();
-		printTimer += pTimer->GetElapsed();
-		if (printTimer >= 1.f)
+		//Dump every new frame while recording
+		if (presentedFrame && isRecording)
 		{
-			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::ostringstream fileName{};
+			fileName << "RayTracing_Recording_" << std::setw(4) << std::setfill('0') << recordedFrame++ << ".png";
+			pRenderer->SaveBufferToImage(*pImageWriter, fileName.str());
 		}
 
-		//Save screenshot after full render
+		//Save screenshot of the last finished frame
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			pRenderer->SaveBufferToImage(*pImageWriter, "RayTracing_Buffer.png");
 			takeScreenshot = false;
 		}
+
+		if (takeHdrScreenshot)
+		{
+			pRenderer->SaveBufferToImage(*pImageWriter, "RayTracing_Buffer.hdr", ImageFormat::HDR);
+			takeHdrScreenshot = false;
+		}
+
+		//sleep until the next input tick, wake early on new events
+		const uint64_t tickDuration = SDL_GetTicks64() - tickStart;
+		if (tickDuration < inputIntervalMs)
+			SDL_WaitEventTimeout(nullptr, static_cast<int>(inputIntervalMs - tickDuration));
 	}
 	pTimer->Stop();
 
+	//stop rendering before the scene and renderer go away
+	delete pRenderThread;
+	delete pImageWriter;
+
 	//Shutdown "framework"
 	delete pScene;
 	delete pRenderer;
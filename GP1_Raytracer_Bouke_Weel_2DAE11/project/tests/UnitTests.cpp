@@ -1,7 +1,18 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include "../src/Vector3.h"
 #include "../src/Vector4.h"
 #include "../src/Matrix.h"
+#include "../src/Denoiser.h"
+#include "../src/ImageWriter.h"
+#include "../src/ResolutionController.h"
+#include "../src/Sampling.h"
+#include "../src/TileScheduler.h"
+#include "../src/Utils.h"
 
 namespace dae
 {
@@ -37,6 +48,411 @@ namespace dae
 
 	// W1
 
+	TEST(ResolutionController, ConvergesToTargetFrameTime) {
+		ResolutionController controller{ 0.033f };
+
+		//full resolution frame costs 100ms, cost scales with the pixel count
+		for (int frame = 0; frame < 50; ++frame)
+			controller.Update(0.1f * controller.GetScale() * controller.GetScale());
+
+		EXPECT_NEAR(std::sqrt(0.033f / 0.1f), controller.GetScale(), 0.01f);
+	}
+
+	TEST(ResolutionController, ClampsScale) {
+		ResolutionController controller{ 0.033f, 0.25f, 1.f };
+
+		controller.Update(10.f); // way too slow
+		EXPECT_EQ(0.25f, controller.GetScale());
+
+		controller.Reset();
+		for (int frame = 0; frame < 10; ++frame)
+			controller.Update(0.001f); // way too fast
+		EXPECT_EQ(1.f, controller.GetScale());
+	}
+
+	TEST(Sampling, CosineHemisphere) {
+		Sampling::Random random{ 1234u };
+		const Vector3 normal{ Vector3{ 1.f, 2.f, -3.f }.Normalized() };
+
+		//E[cos] of a cosine weighted hemisphere is 2/3
+		float cosineSum{ 0.f };
+		constexpr int sampleCount{ 20000 };
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			const Vector3 l{ Sampling::CosineHemisphere(normal, random.Next(), random.Next()) };
+			EXPECT_NEAR(1.f, l.Magnitude(), 1e-4f);
+			EXPECT_GE(Vector3::Dot(normal, l), -1e-6f);
+			cosineSum += Vector3::Dot(normal, l);
+		}
+
+		EXPECT_NEAR(2.f / 3.f, cosineSum / sampleCount, 0.01f);
+	}
+
+	TEST(LightUtils, QuadLightSamplesMatchSolidAngle) {
+		Light light{};
+		light.type = LightType::Quad;
+		light.origin = { 0.f, 4.f, 0.f };
+		light.edge0 = { 2.f, 0.f, 0.f };
+		light.edge1 = { 0.f, 0.f, 2.f };
+		light.direction = Vector3::Cross(light.edge0, light.edge1).Normalized();
+		ASSERT_NEAR(-1.f, light.direction.y, 1e-6f);
+
+		//E[1/pdf] is the solid angle of the light, for a centered a*b rectangle 4*asin(ab / sqrt((a^2+4d^2)(b^2+4d^2)))
+		Sampling::Random random{ 42u };
+		const Vector3 target{};
+		float solidAngle{ 0.f };
+		constexpr int sampleCount{ 4096 };
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			const Vector3 lightPoint{ LightUtils::SampleLightPoint(light, target, random.Next(), random.Next()) };
+			solidAngle += 1.f / LightUtils::GetLightPdf(light, lightPoint, target);
+
+			//BRDF samples towards the sampled point find the light at the same distance
+			const Ray ray{ target, (lightPoint - target).Normalized() };
+			float t{};
+			ASSERT_TRUE(LightUtils::HitTest_Light(light, ray, t));
+			EXPECT_NEAR((lightPoint - target).Magnitude(), t, 1e-4f);
+		}
+
+		EXPECT_NEAR(4.f * asinf(4.f / 68.f), solidAngle / sampleCount, 0.002f);
+
+		//the back of the light doesn't emit
+		float t{};
+		EXPECT_FALSE(LightUtils::HitTest_Light(light, Ray{ { 0.f, 8.f, 0.f }, { 0.f, -1.f, 0.f } }, t));
+	}
+
+	TEST(Frustum, CullsObjectsOutsideTheTile) {
+		//90 degree pyramid looking down +z
+		const Vector3 corners[4]{ { -1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f }, { 1.f, -1.f, 1.f }, { -1.f, -1.f, 1.f } };
+		Frustum frustum{};
+		frustum.Build(Vector3::Zero, corners);
+
+		EXPECT_TRUE(frustum.IsSphereVisible({ 0.f, 0.f, 5.f }, 1.f));
+		//outside, but the radius reaches over the side plane
+		EXPECT_TRUE(frustum.IsSphereVisible({ 6.f, 0.f, 5.f }, 1.f));
+		EXPECT_FALSE(frustum.IsSphereVisible({ 8.f, 0.f, 5.f }, 1.f));
+		EXPECT_FALSE(frustum.IsSphereVisible({ 0.f, 0.f, -5.f }, 1.f));
+
+		EXPECT_TRUE(frustum.IsAABBVisible({ 4.f, -1.f, 5.f }, { 6.f, 1.f, 6.f }));
+		EXPECT_FALSE(frustum.IsAABBVisible({ 6.f, -1.f, 4.f }, { 7.f, 1.f, 5.f }));
+		EXPECT_FALSE(frustum.IsAABBVisible({ -1.f, -1.f, -3.f }, { 1.f, 1.f, -2.f }));
+	}
+
+	TEST(Matrix, Inverse) {
+		const Matrix transform{ Matrix::CreateScale({ 2.f, 2.f, 2.f }) * Matrix::CreateRotationY(0.7f) * Matrix::CreateTranslation({ 1.f, -3.f, 5.f }) };
+		const Matrix inverse{ Matrix::Inverse(transform) };
+
+		const Vector3 point{ 0.5f, 4.f, -2.f };
+		const Vector3 roundTrip{ inverse.TransformPoint(transform.TransformPoint(point)) };
+		EXPECT_NEAR(point.x, roundTrip.x, 1e-5f);
+		EXPECT_NEAR(point.y, roundTrip.y, 1e-5f);
+		EXPECT_NEAR(point.z, roundTrip.z, 1e-5f);
+
+		const Vector3 vector{ inverse.TransformVector(transform.TransformVector(Vector3::UnitX)) };
+		EXPECT_NEAR(1.f, vector.x, 1e-5f);
+		EXPECT_NEAR(0.f, vector.z, 1e-5f);
+	}
+
+	TEST(QuantizedBVH, FindsTheSameClosestHitAsEveryTriangle) {
+		//a wavy grid with a second layer below it, so rays have to pick the closest of several hits
+		TriangleMesh mesh{};
+		mesh.cullMode = TriangleCullMode::NoCulling;
+		constexpr int gridSize{ 24 };
+		for (int layer = 0; layer < 2; ++layer)
+		{
+			for (int z = 0; z < gridSize; ++z)
+			{
+				for (int x = 0; x < gridSize; ++x)
+				{
+					const auto getPoint{ [&](int px, int pz) { return Vector3{ px * 0.25f, sinf(px * 0.7f) * cosf(pz * 0.4f) * 0.3f - layer, pz * 0.25f }; } };
+					mesh.AppendTriangle({ getPoint(x, z), getPoint(x, z + 1), getPoint(x + 1, z) }, true);
+					mesh.AppendTriangle({ getPoint(x + 1, z), getPoint(x, z + 1), getPoint(x + 1, z + 1) }, true);
+				}
+			}
+		}
+		mesh.RotateY(0.6f);
+		mesh.Translate({ -2.f, 1.f, 3.f });
+		mesh.UpdateAABB();
+		mesh.UpdateTransforms();
+
+		//same mesh, traced through the tree
+		TriangleMesh bvhMesh{ mesh };
+		bvhMesh.BuildBVH();
+		EXPECT_TRUE(bvhMesh.transformedPositions.empty());
+
+		Sampling::Random random{ 7u };
+		int hitCount{ 0 };
+		for (int i = 0; i < 2000; ++i)
+		{
+			const Vector3 origin{ random.Next() * 8.f - 6.f, 4.f, random.Next() * 8.f };
+			const Vector3 target{ random.Next() * 8.f - 6.f, -1.f, random.Next() * 8.f };
+			const Ray ray{ origin, (target - origin).Normalized() };
+
+			HitRecord expected{}, actual{};
+			const bool didHit{ GeometryUtils::HitTest_TriangleMesh(mesh, ray, expected) };
+			ASSERT_EQ(didHit, GeometryUtils::HitTest_TriangleMesh(bvhMesh, ray, actual));
+			ASSERT_EQ(didHit, GeometryUtils::HitTest_TriangleMesh(bvhMesh, ray));
+			if (!didHit)
+				continue;
+
+			++hitCount;
+			EXPECT_NEAR(expected.t, actual.t, 1e-4f);
+			EXPECT_NEAR(expected.normal.y, actual.normal.y, 1e-4f);
+			EXPECT_NEAR(expected.origin.x, actual.origin.x, 1e-3f);
+		}
+		EXPECT_GT(hitCount, 500);
+	}
+
+	TEST(QuantizedBVH, FallsBackToMedianSplitsOnDeepTrees) {
+		//small triangles 30% further out every step, taking turns on the three axes: the surface area heuristic
+		//only splits off a few triangles per level, deep enough for the builder to switch to median splits
+		TriangleMesh mesh{};
+		mesh.cullMode = TriangleCullMode::NoCulling;
+		constexpr int triangleCount{ 450 };
+		const auto getCorner{ [](int triangle, int axis) { return std::pow(1.3f, static_cast<float>(triangle / 3)) * Vector3{ axis == 0, axis == 1, axis == 2 }; } };
+		for (int triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			const Vector3 corner{ getCorner(triangle, triangle % 3) };
+			const float size{ corner.Magnitude() * 0.01f };
+			mesh.AppendTriangle({ corner, corner + getCorner(0, (triangle + 1) % 3) * size, corner + getCorner(0, (triangle + 2) % 3) * size }, true);
+		}
+		mesh.UpdateAABB();
+		mesh.UpdateTransforms();
+
+		TriangleMesh bvhMesh{ mesh };
+		bvhMesh.BuildBVH();
+
+		//the edge tests of the far triangles overflow a float, the near ones end up deepest in the tree anyway
+		constexpr int testedTriangleCount{ 240 };
+		for (int triangle = 0; triangle < testedTriangleCount; ++triangle)
+		{
+			//straight down onto the triangle, from a tenth of its distance to the origin
+			const Vector3 corner{ getCorner(triangle, triangle % 3) };
+			const float size{ corner.Magnitude() * 0.01f };
+			const Vector3 inside{ corner + (getCorner(0, (triangle + 1) % 3) + getCorner(0, (triangle + 2) % 3)) * size * 0.25f };
+			const Ray ray{ inside + corner * 0.1f, -corner.Normalized() };
+
+			HitRecord expected{}, actual{};
+			ASSERT_TRUE(GeometryUtils::HitTest_TriangleMesh(mesh, ray, expected));
+			ASSERT_TRUE(GeometryUtils::HitTest_TriangleMesh(bvhMesh, ray, actual));
+			EXPECT_NEAR(expected.t, actual.t, expected.t * 1e-4f);
+		}
+	}
+
+	TEST(TileScheduler, ReassignsTilesOfLostAndSlowWorkers) {
+		TileScheduler scheduler{ { { 0, 0, 0, 8, 8 }, { 0, 8, 0, 8, 8 }, { 0, 0, 8, 8, 8 } } };
+
+		EXPECT_EQ(0, scheduler.Assign(0, 0.0));
+		EXPECT_EQ(1, scheduler.Assign(1, 0.0));
+		EXPECT_EQ(2, scheduler.Assign(2, 0.0));
+
+		//a lost worker's tile is the next one handed out
+		scheduler.Fail(2);
+		EXPECT_TRUE(scheduler.Complete(0, 1.0));
+		EXPECT_EQ(2, scheduler.Assign(0, 1.0));
+		EXPECT_TRUE(scheduler.Complete(0, 2.0));
+
+		//nothing left to queue, worker 1 has been on its tile for far longer than the average of 1 second
+		EXPECT_EQ(-1, scheduler.Assign(0, 2.0));
+		EXPECT_EQ(1, scheduler.Assign(0, 2.0 + TileScheduler::StragglerFactor));
+		EXPECT_TRUE(scheduler.Complete(0, 6.0));
+		EXPECT_TRUE(scheduler.IsFinished());
+
+		//worker 1 is still slower than any straggler, but its tile is done so nobody gets another copy
+		EXPECT_EQ(-1, scheduler.Assign(2, 6.0));
+
+		//the slow copy comes back too late
+		EXPECT_FALSE(scheduler.Complete(1, 7.0));
+		EXPECT_TRUE(scheduler.GetHungWorkers(100.0).empty());
+	}
+
+	TEST(Denoiser, SmoothsNoiseWithoutCrossingEdges) {
+		constexpr int width{ 32 };
+		constexpr int height{ 32 };
+		Denoiser denoiser{};
+		denoiser.Resize(width, height);
+
+		//left half faces the camera at 0.5 with noise, right half is a perpendicular wall at 0.1
+		std::vector<ColorRGB> pixels(width * height);
+		for (int i = 0; i < width * height; ++i)
+		{
+			const bool isLeft{ i % width < width / 2 };
+			const float noise{ (i * 7 % 5 - 2) * 0.02f };
+			pixels[i] = isLeft ? ColorRGB{ 0.5f + noise, 0.5f + noise, 0.5f + noise } : ColorRGB{ 0.1f, 0.1f, 0.1f };
+			denoiser.WriteGuide(i, isLeft ? Vector3::UnitZ : Vector3::UnitX, 5.f, { 1.f, 1.f, 1.f });
+		}
+
+		denoiser.Apply(pixels);
+
+		const int center{ width / 4 + height / 2 * width };
+		EXPECT_NEAR(0.5f, pixels[center].r, 0.01f);
+		//pixels next to the edge don't take anything from the other side
+		EXPECT_NEAR(0.1f, pixels[width / 2 + height / 2 * width].g, 1e-5f);
+	}
+
+	TEST(ImageWriter, WritesValidPNGAndHDR) {
+		const std::filesystem::path pngPath{ std::filesystem::temp_directory_path() / "ImageWriterTest.png" };
+		const std::filesystem::path hdrPath{ std::filesystem::temp_directory_path() / "ImageWriterTest.hdr" };
+
+		//3x2, the last two are clamped the way the window does it
+		const std::vector<ColorRGB> pngPixels{ { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, 0.f }, { 0.5f, 0.5f, 0.5f }, { 2.f, 4.f, 1.f } };
+		const std::vector<uint8_t> expectedScanlines{
+			0, 255, 0, 0, 0, 255, 0, 0, 0, 255,
+			0, 0, 0, 0, 127, 127, 127, 127, 255, 63 };
+
+		//9 wide so the scanlines use the run length layout, every value has an exact RGBE encoding
+		constexpr int hdrWidth{ 9 };
+		constexpr int hdrHeight{ 2 };
+		std::vector<ColorRGB> hdrPixels(hdrWidth * hdrHeight);
+		for (int i = 1; i < hdrWidth * hdrHeight; ++i)
+		{
+			const float scale{ std::ldexp(i % 2 ? 1.f : 3.f, i % 7 - 3) };
+			hdrPixels[i] = { scale, scale * 0.5f, scale * 0.25f };
+		}
+
+		{
+			ImageWriter writer{};
+			writer.Save(std::vector<ColorRGB>{ pngPixels }, 3, 2, pngPath.string(), ImageFormat::PNG);
+			writer.Save(std::vector<ColorRGB>{ hdrPixels }, hdrWidth, hdrHeight, hdrPath.string(), ImageFormat::HDR);
+			//the destructor finishes the queue
+		}
+
+		const auto readFile{ [](const std::filesystem::path& path)
+			{
+				std::ifstream file(path, std::ios::binary);
+				return std::vector<uint8_t>{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+			} };
+		const auto readUint32BigEndian{ [](const std::vector<uint8_t>& bytes, size_t offset)
+			{
+				return static_cast<uint32_t>(bytes[offset]) << 24 | bytes[offset + 1] << 16 | bytes[offset + 2] << 8 | bytes[offset + 3];
+			} };
+		//bit by bit on purpose, independent of the table the writer uses
+		const auto crc32{ [](const uint8_t* pData, size_t size)
+			{
+				uint32_t crc{ 0xFFFFFFFFu };
+				for (size_t i = 0; i < size; ++i)
+				{
+					crc ^= pData[i];
+					for (int bit = 0; bit < 8; ++bit)
+						crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+				}
+				return ~crc;
+			} };
+
+		// PNG
+		const std::vector<uint8_t> png{ readFile(pngPath) };
+		const std::vector<uint8_t> signature{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		ASSERT_GE(png.size(), signature.size());
+		EXPECT_TRUE(std::equal(signature.begin(), signature.end(), png.begin()));
+
+		std::vector<std::string> chunkTypes{};
+		std::vector<uint8_t> zlibData{};
+		for (size_t offset = signature.size(); offset + 12 <= png.size();)
+		{
+			const uint32_t length{ readUint32BigEndian(png, offset) };
+			ASSERT_LE(offset + 12 + length, png.size());
+
+			const std::string type(png.begin() + offset + 4, png.begin() + offset + 8);
+			chunkTypes.push_back(type);
+			EXPECT_EQ(crc32(png.data() + offset + 4, length + 4), readUint32BigEndian(png, offset + 8 + length)) << type;
+
+			if (type == "IHDR")
+			{
+				EXPECT_EQ(3u, readUint32BigEndian(png, offset + 8));
+				EXPECT_EQ(2u, readUint32BigEndian(png, offset + 12));
+			}
+			if (type == "IDAT")
+				zlibData.insert(zlibData.end(), png.begin() + offset + 8, png.begin() + offset + 8 + length);
+
+			offset += 12 + length;
+		}
+		EXPECT_EQ((std::vector<std::string>{ "IHDR", "IDAT", "IEND" }), chunkTypes);
+
+		//zlib header, stored deflate blocks, Adler-32 of the scanlines
+		ASSERT_GE(zlibData.size(), 2u + 5u + 4u);
+		EXPECT_EQ(0, (zlibData[0] << 8 | zlibData[1]) % 31);
+		std::vector<uint8_t> scanlines{};
+		size_t offset{ 2 };
+		bool isFinal{ false };
+		while (!isFinal)
+		{
+			ASSERT_LE(offset + 5, zlibData.size());
+			isFinal = zlibData[offset] & 1;
+			EXPECT_EQ(0, zlibData[offset] >> 1) << "only stored blocks are expected";
+			const uint16_t length{ static_cast<uint16_t>(zlibData[offset + 1] | zlibData[offset + 2] << 8) };
+			const uint16_t inverseLength{ static_cast<uint16_t>(zlibData[offset + 3] | zlibData[offset + 4] << 8) };
+			EXPECT_EQ(static_cast<uint16_t>(~length), inverseLength);
+			ASSERT_LE(offset + 5 + length, zlibData.size());
+			scanlines.insert(scanlines.end(), zlibData.begin() + offset + 5, zlibData.begin() + offset + 5 + length);
+			offset += 5 + length;
+		}
+		EXPECT_EQ(expectedScanlines, scanlines);
+
+		uint32_t a{ 1 }, b{ 0 };
+		for (uint8_t byte : expectedScanlines)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		ASSERT_EQ(offset + 4, zlibData.size());
+		EXPECT_EQ(b << 16 | a, readUint32BigEndian(zlibData, offset));
+
+		// HDR
+		const std::vector<uint8_t> hdr{ readFile(hdrPath) };
+		const std::string header{ "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 2 +X 9\n" };
+		ASSERT_GE(hdr.size(), header.size());
+		EXPECT_EQ(header, std::string(hdr.begin(), hdr.begin() + header.size()));
+
+		offset = header.size();
+		for (int y = 0; y < hdrHeight; ++y)
+		{
+			ASSERT_LE(offset + 4, hdr.size());
+			EXPECT_EQ(2, hdr[offset]);
+			EXPECT_EQ(2, hdr[offset + 1]);
+			EXPECT_EQ(hdrWidth, hdr[offset + 2] << 8 | hdr[offset + 3]);
+			offset += 4;
+
+			//every component is its own row of runs, a count above 128 repeats one byte
+			uint8_t rgbe[4][hdrWidth]{};
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int x = 0; x < hdrWidth;)
+				{
+					ASSERT_LT(offset, hdr.size());
+					const int count{ hdr[offset++] };
+					if (count > 128)
+					{
+						ASSERT_LE(x + count - 128, hdrWidth);
+						std::fill_n(rgbe[c] + x, count - 128, hdr[offset++]);
+						x += count - 128;
+					}
+					else
+					{
+						ASSERT_GT(count, 0);
+						ASSERT_LE(x + count, hdrWidth);
+						ASSERT_LE(offset + count, hdr.size());
+						std::copy_n(hdr.begin() + offset, count, rgbe[c] + x);
+						offset += count;
+						x += count;
+					}
+				}
+			}
+
+			for (int x = 0; x < hdrWidth; ++x)
+			{
+				const ColorRGB& expected{ hdrPixels[x + y * hdrWidth] };
+				const float scale{ rgbe[3][x] == 0 ? 0.f : std::ldexp(1.f, rgbe[3][x] - (128 + 8)) };
+				EXPECT_EQ(expected.r, rgbe[0][x] * scale);
+				EXPECT_EQ(expected.g, rgbe[1][x] * scale);
+				EXPECT_EQ(expected.b, rgbe[2][x] * scale);
+			}
+		}
+		EXPECT_EQ(hdr.size(), offset);
+
+		std::filesystem::remove(pngPath);
+		std::filesystem::remove(hdrPath);
+	}
+
 	int main(int argc, char** argv) {
 		::testing::InitGoogleTest(&argc, argv);
 		return RUN_ALL_TESTS();